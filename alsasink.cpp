@@ -0,0 +1,251 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alsasink.h"
+
+#include <KDebug>
+
+#include <errno.h>
+#include <time.h>
+
+AlsaSink::AlsaSink(const QString &device, bool mmap)
+    : m_device(device)
+    , m_snd(0)
+    , m_periodSize(1024)
+    , m_requestedPeriodSize(1024)
+    , m_requestedPeriods(4)
+    , m_canPause(false)
+    , m_mmap(mmap)
+    , m_mmapAccess(false)
+    , m_mmapOffset(0)
+{
+}
+
+AlsaSink::~AlsaSink()
+{
+    close();
+}
+
+void AlsaSink::setBuffering(int periodFrames, int periods)
+{
+    m_requestedPeriodSize = periodFrames;
+    m_requestedPeriods = periods;
+}
+
+bool AlsaSink::open(const Format &format)
+{
+    if (!m_snd && snd_pcm_open(&m_snd, m_device.toLocal8Bit().constData(), SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        kWarning() << "Could not open ALSA device" << m_device;
+        m_snd = 0;
+        return false;
+    }
+
+    int d = 0;
+    snd_pcm_uframes_t periodSize = m_requestedPeriodSize;
+    snd_pcm_uframes_t bufferSize = periodSize * m_requestedPeriods;
+    unsigned int rate = format.sampleRate;
+
+    snd_pcm_drop(m_snd);
+
+    snd_pcm_hw_params_t *hwParams;
+    snd_pcm_hw_params_malloc(&hwParams);
+    snd_pcm_hw_params_any(m_snd, hwParams);
+    m_mmapAccess = m_mmap && snd_pcm_hw_params_set_access(m_snd, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+    if (!m_mmapAccess) {
+        if (m_mmap) {
+            kDebug() << "ALSA device" << m_device << "cannot be memory mapped, using read/write access";
+        }
+        snd_pcm_hw_params_set_access(m_snd, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
+    snd_pcm_hw_params_set_format(m_snd, hwParams, SND_PCM_FORMAT_S16);
+    snd_pcm_hw_params_set_rate_near(m_snd, hwParams, &rate, 0);
+    snd_pcm_hw_params_set_channels(m_snd, hwParams, format.channels);
+    snd_pcm_hw_params_set_period_size_near(m_snd, hwParams, &periodSize, &d);
+    snd_pcm_hw_params_set_buffer_size_near(m_snd, hwParams, &bufferSize);
+    const int err = snd_pcm_hw_params(m_snd, hwParams);
+    m_canPause = snd_pcm_hw_params_can_pause(hwParams);
+    snd_pcm_hw_params_free(hwParams);
+    if (err < 0) {
+        kWarning() << "Could not configure ALSA device" << m_device << "for" << format.sampleRate << "Hz,"
+                   << format.channels << "channels:" << snd_strerror(err);
+        return false;
+    }
+
+    snd_pcm_sw_params_t *swParams;
+    snd_pcm_sw_params_malloc(&swParams);
+    snd_pcm_sw_params_current(m_snd, swParams);
+    snd_pcm_sw_params_set_avail_min(m_snd, swParams, periodSize);
+    snd_pcm_sw_params_set_start_threshold(m_snd, swParams, 0);
+    snd_pcm_sw_params(m_snd, swParams);
+    snd_pcm_sw_params_free(swParams);
+
+    snd_pcm_prepare(m_snd);
+
+    m_format = Format(rate, format.channels);
+    m_periodSize = periodSize;
+    recordBufferSize(bufferSize);
+    kDebug() << "ALSA device" << m_device << "buffering" << bufferSize << "frames in periods of" << periodSize;
+
+    return true;
+}
+
+void AlsaSink::close()
+{
+    if (m_snd) {
+        snd_pcm_close(m_snd);
+        m_snd = 0;
+    }
+}
+
+AudioSink::Format AlsaSink::format() const
+{
+    return m_format;
+}
+
+int AlsaSink::periodSize() const
+{
+    return m_periodSize;
+}
+
+int AlsaSink::avail()
+{
+    if (!m_snd) {
+        return -ENODEV;
+    }
+    const snd_pcm_sframes_t avail = snd_pcm_avail_update(m_snd);
+    if (avail < 0) {
+        const int err = recover(avail);
+        return err < 0 ? err : 0;
+    }
+    return avail;
+}
+
+bool AlsaSink::wait(int timeout)
+{
+    if (!m_snd) {
+        return false;
+    }
+    const int err = snd_pcm_wait(m_snd, timeout);
+    if (err < 0) {
+        recover(err);
+        return false;
+    }
+    return err > 0;
+}
+
+int AlsaSink::write(const int16_t *data, int frames)
+{
+    if (!m_snd) {
+        return -ENODEV;
+    }
+    const snd_pcm_sframes_t written = m_mmapAccess ? snd_pcm_mmap_writei(m_snd, data, frames)
+                                                   : snd_pcm_writei(m_snd, data, frames);
+    if (written < 0) {
+        const int err = recover(written);
+        return err < 0 ? err : 0;
+    }
+    return written;
+}
+
+bool AlsaSink::hasDirectAccess() const
+{
+    return m_mmapAccess;
+}
+
+int AlsaSink::beginWrite(int16_t **data, int frames)
+{
+    if (!m_snd) {
+        return -ENODEV;
+    }
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t length = frames;
+    const int err = snd_pcm_mmap_begin(m_snd, &areas, &m_mmapOffset, &length);
+    if (err < 0) {
+        const int recovered = recover(err);
+        return recovered < 0 ? recovered : 0;
+    }
+
+    // Interleaved, so the first channel's area covers all of them
+    *data = reinterpret_cast<int16_t*>(static_cast<char*>(areas[0].addr) + areas[0].first / 8
+                                       + m_mmapOffset * areas[0].step / 8);
+    return length;
+}
+
+int AlsaSink::commitWrite(int frames)
+{
+    if (!m_snd) {
+        return -ENODEV;
+    }
+    const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_snd, m_mmapOffset, frames);
+    if (committed < 0 || committed != frames) {
+        const int err = recover(committed < 0 ? committed : -EPIPE);
+        return err < 0 ? err : 0;
+    }
+
+    // Unlike writes, commits do not necessarily start the stream
+    if (committed && snd_pcm_state(m_snd) == SND_PCM_STATE_PREPARED) {
+        snd_pcm_start(m_snd);
+    }
+    return committed;
+}
+
+void AlsaSink::drain()
+{
+    if (!m_snd) {
+        return;
+    }
+    snd_pcm_drain(m_snd);
+    snd_pcm_prepare(m_snd);
+}
+
+void AlsaSink::drop()
+{
+    if (!m_snd) {
+        return;
+    }
+    snd_pcm_drop(m_snd);
+    snd_pcm_prepare(m_snd);
+}
+
+bool AlsaSink::pause(bool pause)
+{
+    return m_snd && m_canPause && snd_pcm_pause(m_snd, pause) >= 0;
+}
+
+int AlsaSink::delay()
+{
+    snd_pcm_sframes_t delay = 0;
+    if (!m_snd || snd_pcm_delay(m_snd, &delay) < 0) {
+        return 0;
+    }
+    return qMax<snd_pcm_sframes_t>(delay, 0);
+}
+
+int AlsaSink::recover(int err)
+{
+    if (err == -EPIPE) {
+        recordUnderrun();
+    }
+    timespec start;
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const int recovered = snd_pcm_recover(m_snd, err, 1);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    recordRecovery((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000);
+    return recovered;
+}
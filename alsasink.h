@@ -0,0 +1,72 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALSASINK_H
+#define ALSASINK_H
+
+#include "audiosink.h"
+
+#include <QtCore/QString>
+
+#include <alsa/asoundlib.h>
+
+/**
+ * Plays through an ALSA device. With @p mmap the device buffer is mapped and
+ * written to directly, falling back to plain read/write access when the
+ * device cannot do that.
+ */
+class AlsaSink
+    : public AudioSink
+{
+public:
+    AlsaSink(const QString &device, bool mmap = false);
+    virtual ~AlsaSink();
+
+    virtual void setBuffering(int periodFrames, int periods);
+    virtual bool open(const Format &format);
+    virtual void close();
+    virtual Format format() const;
+    virtual int periodSize() const;
+    virtual int avail();
+    virtual bool wait(int timeout);
+    virtual int write(const int16_t *data, int frames);
+    virtual bool hasDirectAccess() const;
+    virtual int beginWrite(int16_t **data, int frames);
+    virtual int commitWrite(int frames);
+    virtual void drain();
+    virtual void drop();
+    virtual bool pause(bool pause);
+    virtual int delay();
+
+private:
+    int recover(int err);
+
+    QString            m_device;
+    snd_pcm_t         *m_snd;
+    Format             m_format;
+    snd_pcm_uframes_t  m_periodSize;
+    snd_pcm_uframes_t  m_requestedPeriodSize;
+    unsigned int       m_requestedPeriods;
+    bool               m_canPause;
+    bool               m_mmap;
+    bool               m_mmapAccess;
+    // Where the area handed out by beginWrite() starts
+    snd_pcm_uframes_t  m_mmapOffset;
+};
+
+#endif
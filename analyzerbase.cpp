@@ -12,22 +12,54 @@
 #include <QDebug>
 
 #include "chunk.h"
+#include "audiokernels.h"
+#include "playbackclock.h" //renderTick()
 
 
 // INSTRUCTIONS Base2D
 // 1. do anything that depends on height() in init(), Base2D will call it before you are shown
 // 2. otherwise you can use the constructor to initialise things
 // 3. reimplement analyze(), and paint to canvas(), Base2D will update the widget when you return control to it
-// 4. if you want to manipulate the scope, reimplement transform()
+//    analyze() and animate() are called from the render timer, see setFrameRate()
+// 4. if you want to manipulate the scope, reimplement transform(), it runs on the spectrum thread
 // 5. for convenience <vector> <qpixmap.h> <qwdiget.h> are pre-included
 // TODO make an INSTRUCTIONS file
 //can't mod scope in analyze you have to use transform
 
 
+// Periodic Hann window, scaled to an average of 1 so that windowing does
+// not make the analyzers look quieter
+static void makeWindow(QVector<float> &window)
+{
+    const int size = window.size();
+    for (int i = 0; i < size; ++i)
+        window[i] = 1.0 - cos( 2 * M_PI * i / size );
+}
+
 Analyzer::Base::Base(QWidget *parent, uint scopeSize)
         : QWidget(parent)
         , m_fht(new FHT(scopeSize))
+        , m_fhtBuffer(m_fht->size())
+        , m_input(m_fht->size())
+        , m_window(m_fht->size())
+        , m_history(m_fht->size(), 0)
+        , m_historyPos(0)
+        , m_sinceHop(0)
+        , m_spectra(0)
+        , m_droppedSpectra(0)
+        , m_demoScope(32)
+        , m_demoFrame(201)
+        , m_frameRate(0)
+        , m_lastTick(0)
+        , m_renderedFrames(0)
+        , m_skippedFrames(0)
+        , m_frameMicroseconds(0)
+        , m_maxFrameMicroseconds(0)
 {
+    makeWindow(m_window);
+
+    connect(&m_renderTimer, SIGNAL(timeout()), this, SLOT(renderTick()));
+    setFrameRate(30);
 }
 
 void Analyzer::Base::transform(QVector<float> &scope ) //virtual
@@ -35,37 +67,155 @@ void Analyzer::Base::transform(QVector<float> &scope ) //virtual
     //this is a standard transformation that should give
     //an FFT scope that has bands for pretty analyzers
 
-    //NOTE resizing here is redundant as FHT routines only calculate FHT::size() values
-    //scope.resize( m_fht->size() );
-
     float *front = static_cast<float*>( &scope.front() );
 
-    float* f = new float[ m_fht->size() ];
-    m_fht->copy( &f[0], front );
-    m_fht->logSpectrum( front, &f[0] );
-    m_fht->scale( front, 1.0 / 20 );
-
-    scope.resize( m_fht->size() / 2 ); //second half of values are rubbish
-    delete [] f;
+    float *f = m_fhtBuffer.data();
+    m_fht->copy( f, front );
+    m_fht->logSpectrum( front, f );
+    m_fht->scale( front, 1.0 / 20 ); //second half of values are rubbish
 }
 
-void Analyzer::Base::drawFrame(const Chunk &thescope)
+void Analyzer::Base::processChunk(const Chunk &thescope, bool behind)
 {
-    if (thescope.m_dataFrames < m_fht->size())
+    // The mono downmix goes into a ring holding the last FHT::size()
+    // frames; a spectrum is due every half of that, wherever the chunks
+    // happen to start and end
+    const int size = m_fht->size();
+    const int hop = size / 2;
+    const int channels = thescope.m_channels;
+    const int16_t *const data = thescope.m_block.data();
+    float *const history = m_history.data();
+
+    int hops = 0;
+    for (int done = 0; done < thescope.m_dataFrames; ) {
+        const int frames = qMin(qMin(thescope.m_dataFrames - done, size - m_historyPos), hop - m_sinceHop);
+        AudioKernels::downmixToFloat(data + done * channels, history + m_historyPos, frames, channels);
+        m_historyPos = (m_historyPos + frames) % size;
+        m_sinceHop += frames;
+        done += frames;
+        if (m_sinceHop == hop) {
+            m_sinceHop = 0;
+            ++hops;
+        }
+    }
+    if (!hops)
         return;
 
-    static QVector<float> scope( m_fht->size() );
-    for(int x = 0; x < m_fht->size(); x++)
-    {
-       scope[x] = double(((int16_t*)thescope.m_data)[x*2] >> 31);
+    // Only the latest spectrum would be seen; when more chunks are waiting
+    // not even that one
+    if (behind) {
+        m_droppedSpectra.fetchAndAddRelaxed(hops);
+        return;
     }
+    m_droppedSpectra.fetchAndAddRelaxed(hops - 1);
+    m_spectra.ref();
+
+    // Oldest frame first
+    float *const scope = m_input.data();
+    const float *const window = m_window.constData();
+    const int older = size - m_historyPos;
+    for (int x = 0; x < older; ++x)
+        scope[x] = history[m_historyPos + x] * window[x];
+    for (int x = older; x < size; ++x)
+        scope[x] = history[x - older] * window[x];
+
+    transform(m_input);
+
+    // Each of the three spectra is sized on its first use only
+    const int bands = m_fht->size() / 2;
+    QVector<float> &spectrum = m_spectrum.back();
+    if (spectrum.size() != bands)
+        spectrum.resize( bands );
+    qCopy( m_input.constBegin(), m_input.constBegin() + bands, spectrum.begin() );
+    m_spectrum.publish();
+}
 
-    transform(scope);
-    analyze(scope);
+int Analyzer::Base::spectra() const
+{
+    return m_spectra;
+}
+
+int Analyzer::Base::droppedSpectra() const
+{
+    return m_droppedSpectra;
+}
+
+void Analyzer::Base::setFrameRate(int fps)
+{
+    if (fps < 23)
+        fps = 15;
+    else if (fps < 45)
+        fps = 30;
+    else
+        fps = 60;
+
+    m_frameRate = fps;
+    m_renderTimer.setInterval(1000 / fps);
+}
+
+int Analyzer::Base::frameRate() const
+{
+    return m_frameRate;
+}
+
+Analyzer::Base::RenderStats Analyzer::Base::renderStats() const
+{
+    RenderStats stats;
+    stats.frames = m_renderedFrames;
+    stats.skipped = m_skippedFrames;
+    stats.averageMicroseconds = m_renderedFrames ? m_frameMicroseconds / m_renderedFrames : 0;
+    stats.maxMicroseconds = m_maxFrameMicroseconds;
+    return stats;
+}
+
+bool Analyzer::Base::animate(int, bool fresh) //virtual
+{
+    return fresh;
+}
+
+void Analyzer::Base::showEvent(QShowEvent *e)
+{
+    QWidget::showEvent(e);
+
+    m_lastTick = PlaybackClock::now();
+    m_renderTimer.start();
+}
+
+void Analyzer::Base::hideEvent(QHideEvent *e)
+{
+    QWidget::hideEvent(e);
+
+    m_renderTimer.stop();
+}
+
+void Analyzer::Base::renderTick()
+{
+    // Animations follow the clock, not the ticks, which the event loop may
+    // deliver late
+    const qint64 now = PlaybackClock::now();
+    int elapsed = int((now - m_lastTick) / 1000);
+    if (elapsed > 1000) {
+        elapsed = 1000;
+        m_lastTick = now;
+    }
+    else
+        m_lastTick += qint64(elapsed) * 1000; // keep the part of a millisecond
+
+    const bool fresh = m_spectrum.fetch();
+    if (fresh)
+        analyze(m_spectrum.front());
+
+    if (!animate(elapsed, fresh)) {
+        ++m_skippedFrames;
+        return;
+    }
 
-    scope.resize( m_fht->size() );
+    repaint();
 
-    update();
+    const int frameTime = int(PlaybackClock::now() - now);
+    m_frameMicroseconds += frameTime;
+    m_maxFrameMicroseconds = qMax(m_maxFrameMicroseconds, frameTime);
+    ++m_renderedFrames;
 }
 
 int Analyzer::Base::resizeExponent( int exp )
@@ -78,6 +228,13 @@ int Analyzer::Base::resizeExponent( int exp )
     if ( exp != m_fht->sizeExp() ) {
         delete m_fht;
         m_fht = new FHT( exp );
+        m_fhtBuffer.resize( m_fht->size() );
+        m_input.resize( m_fht->size() );
+        m_window.resize( m_fht->size() );
+        makeWindow( m_window );
+        m_history.fill( 0, m_fht->size() );
+        m_historyPos = 0;
+        m_sinceHop = 0;
     }
     return exp;
 }
@@ -107,12 +264,12 @@ void Analyzer::Base::paused() //virtual
 
 void Analyzer::Base::demo() //virtual
 {
-    static int t = 201; //FIXME make static to namespace perhaps
+    int &t = m_demoFrame;
 
     if( t > 999 ) t = 1; //0 = wasted calculations
     if( t < 201 )
     {
-        QVector<float> s( 32 );
+        QVector<float> &s = m_demoScope;
 
         const double dt = double(t) / 200;
         for(int i = 0; i < s.size(); ++i)
@@ -10,6 +10,7 @@
 #endif
 
 #include "fht.h"     //stack allocated and convenience
+#include "triplebuffer.h"
 #include <qpixmap.h> //stack allocated and convenience
 #include <qtimer.h>  //stack allocated
 #include <qwidget.h> //baseclass
@@ -18,6 +19,8 @@
 class QEvent;
 class QPaintEvent;
 class QResizeEvent;
+class QShowEvent;
+class QHideEvent;
 class Chunk;
 
 
@@ -29,21 +32,99 @@ class Base : public QWidget
 {
     Q_OBJECT
 
-public slots:
-    void drawFrame(const Chunk &thescope);
+public:
+    /**
+     * Called on the spectrum thread with a chunk of what is being played.
+     * The channels are mixed down and windowed frames of FHT::size()
+     * values, overlapping by half, are transformed and published for the
+     * widget to pick up on its next render tick. When @p behind, because more
+     * chunks are waiting, the frames are only kept for the next ones.
+     * Nothing here may touch the widget.
+     */
+    void processChunk(const Chunk &thescope, bool behind = false);
+
+    /**
+     * Spectra published, and frames dropped because a later one was due
+     * already or the spectrum thread was behind.
+     */
+    int spectra() const;
+    int droppedSpectra() const;
+
+    struct RenderStats {
+        int frames;              ///< ticks that repainted
+        int skipped;             ///< ticks with nothing new to show
+        int averageMicroseconds; ///< analyzing, animating and repainting
+        int maxMicroseconds;
+    };
+
+    /**
+     * Repaints from a single timer, @p fps times a second while shown.
+     * 15, 30 and 60 are supported, other rates are rounded to the nearest.
+     */
+    void setFrameRate( int fps );
+    int  frameRate() const;
+
+    RenderStats renderStats() const;
 
 protected:
     Base(QWidget*, uint = 7);
     ~Base() { delete m_fht; }
 
+    // Only before the spectrum thread starts, it uses m_fht and the
+    // buffers sized here
     int  resizeExponent(int);
     int  resizeForBands(int);
+
+    /**
+     * Runs on the spectrum thread, may only use m_fht and m_fhtBuffer.
+     * Works in place on the m_fht->size() values of the scope and leaves
+     * half as many bands at its front; it must not resize it.
+     */
     virtual void transform(QVector<float>&);
     virtual void analyze(const QVector<float>&) = 0;
     virtual void paused();
     virtual void demo();
 
+    /**
+     * Called on every tick of the render timer, @p milliseconds after the
+     * previous one, once the latest spectrum, if @p fresh, went through
+     * analyze(). Moves whatever animates on by that time and returns
+     * whether the widget looks any different; the tick is skipped when it
+     * does not. By default only a fresh spectrum is worth a repaint.
+     */
+    virtual bool animate( int milliseconds, bool fresh );
+
+    void showEvent( QShowEvent* );
+    void hideEvent( QHideEvent* );
+
     FHT    *m_fht;
+    QVector<float> m_fhtBuffer;
+
+private slots:
+    void renderTick();
+
+private:
+    // The input and the published spectra are sized once, so that a frame
+    // does not allocate
+    QVector<float>                m_input;
+    QVector<float>                m_window;
+    QVector<float>                m_history;
+    int                           m_historyPos;
+    int                           m_sinceHop;
+    TripleBuffer<QVector<float> > m_spectrum;
+    mutable QAtomicInt            m_spectra;
+    mutable QAtomicInt            m_droppedSpectra;
+    QVector<float>                m_demoScope;
+    int                           m_demoFrame;
+
+    // Render timer, GUI thread only
+    QTimer                        m_renderTimer;
+    int                           m_frameRate;
+    qint64                        m_lastTick;
+    int                           m_renderedFrames;
+    int                           m_skippedFrames;
+    qint64                        m_frameMicroseconds;
+    int                           m_maxFrameMicroseconds;
 };
 
 
@@ -0,0 +1,1482 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmarks of the audio path and of the block analyzer canvas, which
+// also check that they still do what they should. Runs every section, or
+// only those named on the command line; --quick keeps each of them short
+// enough to run as a test. Exits with a non-zero status if any check
+// failed.
+
+#include "audiograph.h"
+#include "audiokernels.h"
+#include "audionode.h"
+#include "blockcanvas.h"
+#include "chunk.h"
+#include "crossfader.h"
+#include "equalizer.h"
+#include "feedercommandqueue.h"
+#include "fht.h"
+#include "formatconverter.h"
+#include "loudnessnormalizer.h"
+#include "pcmblockpool.h"
+#include "pcmringbuffer.h"
+#include "playbackclock.h"
+#include "realfft.h"
+#include "spectrumtap.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+
+#include <math.h>
+#include <new>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool s_quick = false;
+static int s_failures = 0;
+
+static void check(bool condition, const char *section, const char *what)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: FAILED: %s\n", section, what);
+        ++s_failures;
+    }
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    return sorted[qMin(sorted.count() - 1, sorted.count() * percent / 100)];
+}
+
+namespace {
+
+class FunctionThread
+    : public QThread
+{
+public:
+    FunctionThread(void (*function)(void*), void *argument)
+        : m_function(function)
+        , m_argument(argument)
+    {
+    }
+
+protected:
+    virtual void run()
+    {
+        m_function(m_argument);
+    }
+
+private:
+    void (*m_function)(void*);
+    void  *m_argument;
+};
+
+}
+
+//BEGIN: ring
+namespace {
+
+/**
+ * Moves interleaved stereo frames from a producer thread to a consumer
+ * thread.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() {}
+
+    /**
+     * Returns how many frames were taken, which can be less than asked.
+     */
+    virtual int write(const int16_t *frames, int numFrames) = 0;
+
+    /**
+     * Blocks until there is something to read.
+     */
+    virtual int read(int16_t *frames, int maxFrames) = 0;
+};
+
+class RingTransport
+    : public Transport
+{
+public:
+    RingTransport(int capacitySamples)
+        : m_ring(capacitySamples)
+    {
+        m_ring.setFormat(44100, 2);
+    }
+
+    virtual int write(const int16_t *frames, int numFrames)
+    {
+        return m_ring.write(frames, numFrames);
+    }
+
+    virtual int read(int16_t *frames, int maxFrames)
+    {
+        while (true) {
+            PcmRingBuffer::Marker marker;
+            if (m_ring.takeMarker(&marker)) {
+                continue;
+            }
+            const int read = m_ring.read(frames, maxFrames);
+            if (read) {
+                return read;
+            }
+            m_ring.waitForData(100);
+        }
+    }
+
+private:
+    PcmRingBuffer m_ring;
+};
+
+/**
+ * What the ring replaced: every delivery copied into a chunk of its own,
+ * queued under a mutex, and the feeder waiting on a condition.
+ */
+class QueueTransport
+    : public Transport
+{
+public:
+    QueueTransport(int capacitySamples)
+        : m_capacity(capacitySamples)
+        , m_queued(0)
+        , m_offset(0)
+    {
+        m_current.data = 0;
+        m_current.samples = 0;
+    }
+
+    ~QueueTransport()
+    {
+        delete[] m_current.data;
+        while (!m_queue.isEmpty()) {
+            delete[] m_queue.dequeue().data;
+        }
+    }
+
+    virtual int write(const int16_t *frames, int numFrames)
+    {
+        Chunk chunk;
+        chunk.samples = numFrames * 2;
+        chunk.data = new int16_t[chunk.samples];
+        memcpy(chunk.data, frames, chunk.samples * sizeof(int16_t));
+        QMutexLocker locker(&m_mutex);
+        while (m_queued + chunk.samples > m_capacity && m_queued) {
+            m_notFull.wait(&m_mutex);
+        }
+        m_queue.enqueue(chunk);
+        m_queued += chunk.samples;
+        m_notEmpty.wakeAll();
+        return numFrames;
+    }
+
+    virtual int read(int16_t *frames, int maxFrames)
+    {
+        if (m_offset == m_current.samples) {
+            delete[] m_current.data;
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty()) {
+                m_notEmpty.wait(&m_mutex);
+            }
+            m_current = m_queue.dequeue();
+            m_offset = 0;
+            m_queued -= m_current.samples;
+            m_notFull.wakeAll();
+        }
+        const int samples = qMin(m_current.samples - m_offset, maxFrames * 2);
+        memcpy(frames, m_current.data + m_offset, samples * sizeof(int16_t));
+        m_offset += samples;
+        return samples / 2;
+    }
+
+private:
+    struct Chunk {
+        int16_t *data;
+        int      samples;
+    };
+
+    const int      m_capacity;
+    int            m_queued;
+    QQueue<Chunk>  m_queue;
+    QMutex         m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+
+    // Owned by the consumer
+    Chunk          m_current;
+    int            m_offset;
+};
+
+struct RingRun {
+    Transport *transport;
+    int        chunkFrames;
+    int        chunks;
+    // Microseconds between chunks, 0 to write as fast as possible
+    int        pace;
+    // When each chunk started to be written
+    qint64    *written;
+};
+
+// Sample n of the stream is n & 0x7fff, so the reader can tell if anything
+// got lost, duplicated or reordered
+void ringProducer(void *argument)
+{
+    RingRun *run = static_cast<RingRun*>(argument);
+    int16_t *chunk = new int16_t[run->chunkFrames * 2];
+    uint32_t sample = 0;
+    const qint64 start = PlaybackClock::now();
+    for (int i = 0; i < run->chunks; ++i) {
+        for (int j = 0; j < run->chunkFrames * 2; ++j) {
+            chunk[j] = sample++ & 0x7fff;
+        }
+        if (run->pace) {
+            const qint64 wait = start + qint64(i) * run->pace - PlaybackClock::now();
+            if (wait > 0) {
+                usleep(wait);
+            }
+        }
+        run->written[i] = PlaybackClock::now();
+        int done = 0;
+        while (done < run->chunkFrames) {
+            const int written = run->transport->write(chunk + done * 2, run->chunkFrames - done);
+            if (!written) {
+                QThread::yieldCurrentThread();
+            }
+            done += written;
+        }
+    }
+    delete[] chunk;
+}
+
+struct RingResult {
+    double          framesPerSecond;
+    QVector<qint64> latencies;
+    bool            intact;
+};
+
+RingResult runRing(Transport *transport, int chunkFrames, int chunks, int pace)
+{
+    RingRun run;
+    run.transport = transport;
+    run.chunkFrames = chunkFrames;
+    run.chunks = chunks;
+    run.pace = pace;
+    run.written = new qint64[chunks];
+
+    RingResult result;
+    result.intact = true;
+    result.latencies.reserve(chunks);
+
+    const int blockFrames = 1024;
+    int16_t *block = new int16_t[blockFrames * 2];
+    const qint64 totalFrames = qint64(chunkFrames) * chunks;
+    qint64 framesRead = 0;
+    int chunksRead = 0;
+
+    FunctionThread producer(ringProducer, &run);
+    const qint64 start = PlaybackClock::now();
+    producer.start();
+    while (framesRead < totalFrames) {
+        const int read = transport->read(block, blockFrames);
+        for (int i = 0; i < read * 2; ++i) {
+            if (block[i] != int16_t((framesRead * 2 + i) & 0x7fff)) {
+                result.intact = false;
+            }
+        }
+        framesRead += read;
+        const qint64 now = PlaybackClock::now();
+        while (chunksRead < chunks && qint64(chunksRead + 1) * chunkFrames <= framesRead) {
+            result.latencies.append(now - run.written[chunksRead]);
+            ++chunksRead;
+        }
+    }
+    const qint64 elapsed = qMax(PlaybackClock::now() - start, qint64(1));
+    producer.wait();
+
+    result.framesPerSecond = totalFrames * 1000000.0 / elapsed;
+    qSort(result.latencies.begin(), result.latencies.end());
+
+    delete[] block;
+    delete[] run.written;
+    return result;
+}
+
+void reportRing(const char *name, const RingResult &result)
+{
+    printf("ring: %-6s %8.1f Mframes/s\n", name, result.framesPerSecond / 1e6);
+    check(result.intact, "ring", "frames lost or out of order");
+}
+
+void reportHandoff(const char *name, const RingResult &result)
+{
+    printf("ring: %-6s handoff p50 %4lld us, p99 %4lld us, max %5lld us\n", name,
+           percentile(result.latencies, 50), percentile(result.latencies, 99),
+           result.latencies.isEmpty() ? 0LL : result.latencies.last());
+    check(result.intact, "ring", "frames lost or out of order");
+}
+
+}
+
+// Throughput with the producer as fast as it can go, then how long a
+// delivery paced like libspotify's takes to reach the feeder
+static void benchmarkRing()
+{
+    const int capacity = 44100 * 2;
+    const int chunkFrames = 2048;
+    const int chunks = s_quick ? 500 : 25000;
+    const int pacedChunks = s_quick ? 200 : 5000;
+    const int pacedFrames = 441;
+
+    {
+        RingTransport ring(capacity);
+        reportRing("ring", runRing(&ring, chunkFrames, chunks, 0));
+        QueueTransport queue(capacity);
+        reportRing("queue", runRing(&queue, chunkFrames, chunks, 0));
+    }
+    {
+        RingTransport ring(capacity);
+        reportHandoff("ring", runRing(&ring, pacedFrames, pacedChunks, 1000));
+        QueueTransport queue(capacity);
+        reportHandoff("queue", runRing(&queue, pacedFrames, pacedChunks, 1000));
+    }
+}
+//END: ring
+
+//BEGIN: markers
+/**
+ * Runs the producer in the window between discard() loading the marker
+ * write position and the write position, which a thread can be preempted
+ * in at any time.
+ */
+class MarkerRace
+{
+public:
+    MarkerRace(PcmRingBuffer *ring)
+        : m_ring(ring)
+        , m_markerWritePos(ring->m_markerWritePos.fetchAndAddAcquire(0))
+    {
+    }
+
+    void discard()
+    {
+        m_ring->discardFrom(m_markerWritePos);
+    }
+
+private:
+    PcmRingBuffer *m_ring;
+    uint32_t       m_markerWritePos;
+};
+
+namespace {
+
+// Takes and reads everything there is; false if something is left that
+// can be neither read nor taken
+bool drainMarkers(PcmRingBuffer *ring, QVector<PcmRingBuffer::MarkerType> *taken)
+{
+    int16_t frames[64 * 2];
+    while (true) {
+        PcmRingBuffer::Marker marker;
+        if (ring->takeMarker(&marker)) {
+            taken->append(marker.type);
+        } else if (!ring->read(frames, 64)) {
+            break;
+        }
+    }
+    return !ring->waitForData(0);
+}
+
+}
+
+// What seeking can run into while libspotify delivers: markers queued
+// while discard() runs are kept, and end up behind the read position once
+// the discard is applied. The consumer has to take them and carry on
+// rather than wait on them for good.
+static void benchmarkMarkers()
+{
+    int16_t frames[64 * 2];
+    memset(frames, 0, sizeof(frames));
+    const int races = s_quick ? 10000 : 1000000;
+
+    PcmRingBuffer ring(4096);
+    ring.setFormat(44100, 2);
+    QVector<PcmRingBuffer::MarkerType> taken;
+    bool drained = drainMarkers(&ring, &taken);
+    int stalls = 0;
+    int lost = 0;
+    int rates = 0;
+
+    const qint64 start = PlaybackClock::now();
+    for (int i = 0; i < races; ++i) {
+        taken.clear();
+
+        // The end of a track before the discard is dropped with it, the
+        // next track announced in the window is not
+        ring.write(frames, 64);
+        ring.writeMarker(PcmRingBuffer::EndOfTrack);
+        ring.write(frames, 64);
+        MarkerRace race(&ring);
+        ring.writeMarker(PcmRingBuffer::EndOfTrack);
+        const int sampleRate = i % 2 ? 44100 : 48000;
+        ring.setFormat(sampleRate, 2);
+        ring.write(frames, 64);
+        race.discard();
+
+        if (!drainMarkers(&ring, &taken)) {
+            ++stalls;
+            // Drop what is stuck, so the next race starts out empty
+            ring.discard();
+            drainMarkers(&ring, &taken);
+            continue;
+        }
+        if (taken.count() != 2 || taken[0] != PcmRingBuffer::EndOfTrack || taken[1] != PcmRingBuffer::FormatChange) {
+            ++lost;
+        }
+        if (ring.sampleRate() != sampleRate) {
+            ++rates;
+        }
+    }
+    const qint64 elapsed = qMax(PlaybackClock::now() - start, qint64(1));
+
+    printf("markers: %d discard races in %lld us, %d left stuck\n", races, elapsed, stalls);
+    check(drained, "markers", "the ring could not be emptied before the races");
+    check(!stalls, "markers", "a marker left behind the read position was never taken");
+    check(!lost, "markers", "markers queued during a discard were dropped or reordered");
+    check(!rates, "markers", "a format change queued during a discard was not applied");
+}
+//END: markers
+
+//BEGIN: resampler
+// Converts a 1 kHz tone from 44.1 kHz to 48 kHz in delivery sized blocks,
+// on a single thread
+static void benchmarkResampler()
+{
+    const int blockFrames = 2048;
+    const int seconds = s_quick ? 10 : 600;
+    const qint64 totalFrames = qint64(seconds) * 44100;
+
+    int16_t *input = new int16_t[44100 * 2];
+    for (int i = 0; i < 44100; ++i) {
+        input[i * 2] = input[i * 2 + 1] = int16_t(16000 * sin(2 * M_PI * 1000 * i / 44100.0));
+    }
+    const int outputCapacity = blockFrames * 2;
+    int16_t *output = new int16_t[outputCapacity * 2];
+
+    FormatConverter converter(blockFrames);
+    converter.setFormats(AudioSink::Format(44100, 2), AudioSink::Format(48000, 2));
+
+    qint64 framesIn = 0;
+    qint64 framesOut = 0;
+    double energy = 0;
+    qint64 measured = 0;
+    const qint64 start = PlaybackClock::now();
+    while (framesIn < totalFrames) {
+        const int offset = framesIn % 44100;
+        const int frames = qMin(qMin(blockFrames, 44100 - offset), converter.maxInputFrames(outputCapacity));
+        const int converted = converter.convert(input + offset * 2, frames, output);
+        // The tone, away from where the filter starts up, should come out
+        // as loud as it went in
+        if (framesIn >= 44100 && measured < 48000) {
+            for (int i = 0; i < converted * 2; ++i) {
+                energy += double(output[i]) * output[i];
+            }
+            measured += converted;
+        }
+        framesIn += frames;
+        framesOut += converted;
+    }
+    const qint64 elapsed = qMax(PlaybackClock::now() - start, qint64(1));
+
+    const double framesPerSecond = framesIn * 1000000.0 / elapsed;
+    printf("resampler: 44100 -> 48000 Hz stereo (%s) %6.2f Mframes/s per core, %5.0fx real time\n",
+           AudioKernels::instructionSet(), framesPerSecond / 1e6, framesPerSecond / 44100);
+
+    const double expected = qint64(framesIn) * 48000.0 / 44100;
+    check(qAbs(framesOut - expected) < 64, "resampler", "wrong number of frames out");
+    const double rms = sqrt(energy / qMax(measured * 2, qint64(1)));
+    check(qAbs(rms - 16000 / sqrt(2.0)) < 16000 * 0.05, "resampler", "tone level changed");
+
+    delete[] input;
+    delete[] output;
+}
+//END: resampler
+
+//BEGIN: equalizer
+// Peaking bands at +6dB spread over the spectrum, filtering 44.1 kHz
+// stereo in graph sized blocks
+static void benchmarkEqualizer()
+{
+    const int blockFrames = 256;
+    const int blocksPerSecond = 44100 / blockFrames;
+    const int seconds = s_quick ? 5 : 120;
+    const int blocks = seconds * blocksPerSecond;
+    const int bandCounts[] = { 1, 2, 4, 8, 10, 16 };
+
+    // A second of pink-ish noise, copied in block after block
+    float *source = new float[blocksPerSecond * blockFrames * 2];
+    float *block = new float[blockFrames * 2];
+    uint32_t random = 1;
+    float lowPassed = 0;
+    for (int i = 0; i < blocksPerSecond * blockFrames; ++i) {
+        random = random * 1664525 + 1013904223;
+        lowPassed = 0.9f * lowPassed + 0.1f * (int32_t(random) / 2147483648.0f);
+        source[i * 2] = source[i * 2 + 1] = lowPassed;
+    }
+
+    // What copying the source costs, to take out of the timings
+    qint64 start = PlaybackClock::now();
+    for (int i = 0; i < blocks; ++i) {
+        memcpy(block, source + (i % blocksPerSecond) * blockFrames * 2, blockFrames * 2 * sizeof(float));
+        __asm__ __volatile__("" : : "r"(block) : "memory");
+    }
+    const qint64 copying = PlaybackClock::now() - start;
+
+    Equalizer::Band bands[Equalizer::MaxBands];
+    for (int i = 0; i < Equalizer::MaxBands; ++i) {
+        bands[i].type = Equalizer::Peaking;
+        bands[i].frequency = 31.25 * pow(2.0, i * 9.0 / (Equalizer::MaxBands - 1));
+        bands[i].gain = 6;
+        bands[i].q = 1.4;
+    }
+
+    for (unsigned int n = 0; n < sizeof(bandCounts) / sizeof(int); ++n) {
+        const int count = bandCounts[n];
+        Equalizer equalizer;
+        equalizer.setFormat(44100, 2);
+        equalizer.setBands(true, bands, count);
+
+        // Let the bands glide to their gains, then time a steady state
+        for (int i = 0; i < blocksPerSecond; ++i) {
+            memcpy(block, source + i * blockFrames * 2, blockFrames * 2 * sizeof(float));
+            equalizer.process(block, blockFrames);
+        }
+        check(equalizer.activeBands() == count, "equalizer", "bands left out of the cascade");
+
+        bool finite = true;
+        start = PlaybackClock::now();
+        for (int i = 0; i < blocks; ++i) {
+            memcpy(block, source + (i % blocksPerSecond) * blockFrames * 2, blockFrames * 2 * sizeof(float));
+            equalizer.process(block, blockFrames);
+            finite = finite && qAbs(block[0]) < 100;
+        }
+        const qint64 elapsed = qMax(PlaybackClock::now() - start - copying, qint64(0));
+        check(finite, "equalizer", "output blew up");
+
+        const double nsPerFrame = elapsed * 1000.0 / (qint64(blocks) * blockFrames);
+        printf("equalizer: %2d bands %7.2f ns/frame, %5.2f ns/frame per band, %5.3f%% of a core\n",
+               count, nsPerFrame, nsPerFrame / count, nsPerFrame * 44100 / 1e7);
+    }
+
+    // Disabled, it glides to flat and then drops out
+    Equalizer equalizer;
+    equalizer.setFormat(44100, 2);
+    equalizer.setBands(true, bands, 4);
+    equalizer.process(block, blockFrames);
+    equalizer.setBands(false, bands, 4);
+    for (int i = 0; i < blocksPerSecond; ++i) {
+        memcpy(block, source + i * blockFrames * 2, blockFrames * 2 * sizeof(float));
+        equalizer.process(block, blockFrames);
+    }
+    check(!equalizer.isActive(), "equalizer", "still active after being disabled");
+
+    delete[] source;
+    delete[] block;
+}
+//END: equalizer
+
+//BEGIN: graph
+namespace {
+
+class GainNode
+    : public AudioNode
+{
+public:
+    GainNode(float gain)
+        : m_gain(gain)
+        , m_channels(2)
+    {
+    }
+
+    virtual const char *name() const
+    {
+        return "gain";
+    }
+
+    virtual void setFormat(int, int channels)
+    {
+        m_channels = channels;
+    }
+
+    virtual void reset()
+    {
+    }
+
+    virtual bool isActive() const
+    {
+        return true;
+    }
+
+    virtual void process(float *data, int frames)
+    {
+        for (int i = 0; i < frames * m_channels; ++i) {
+            data[i] *= m_gain;
+        }
+    }
+
+private:
+    const float m_gain;
+    int         m_channels;
+};
+
+/**
+ * Stands in for a visualization tap: reads every sample, changes nothing.
+ */
+class PeakMeter
+    : public AudioNode
+{
+public:
+    PeakMeter()
+        : m_channels(2)
+        , m_peak(0)
+    {
+    }
+
+    float peak() const
+    {
+        return m_peak;
+    }
+
+    virtual const char *name() const
+    {
+        return "meter";
+    }
+
+    virtual void setFormat(int, int channels)
+    {
+        m_channels = channels;
+    }
+
+    virtual void reset()
+    {
+        m_peak = 0;
+    }
+
+    virtual bool isActive() const
+    {
+        return true;
+    }
+
+    virtual void process(float *data, int frames)
+    {
+        for (int i = 0; i < frames * m_channels; ++i) {
+            m_peak = qMax(m_peak, qAbs(data[i]));
+        }
+    }
+
+private:
+    int   m_channels;
+    float m_peak;
+};
+
+struct StatsReader {
+    const AudioGraph *graph;
+    int               chunkFrames;
+    QAtomicInt        done;
+    bool              consistent;
+    int               reads;
+};
+
+// Reads the node statistics while they are being written. Frames always
+// grow by whole chunks, so a torn read would show.
+void readStats(void *argument)
+{
+    StatsReader *reader = static_cast<StatsReader*>(argument);
+    qint64 last = 0;
+    while (!reader->done.fetchAndAddAcquire(0)) {
+        const AudioGraph::NodeStats stats = reader->graph->nodeStats(0);
+        if (stats.frames < last || stats.frames % reader->chunkFrames || stats.microseconds < 0) {
+            reader->consistent = false;
+        }
+        last = stats.frames;
+        ++reader->reads;
+    }
+}
+
+}
+
+// The feeder's three nodes and two more, over an hour of synthetic 44.1 kHz
+// stereo (a minute with --quick), with the crossfader restarted whenever
+// it is done so that the schedule keeps being compiled again
+static void benchmarkGraph()
+{
+    const int chunkFrames = 4096;
+    const int seconds = s_quick ? 60 : 3600;
+    const qint64 totalFrames = qint64(seconds) * 44100;
+    const int fadeFrames = 44100 * 10;
+
+    const int sourceFrames = 44100;
+    int16_t *source = new int16_t[sourceFrames * 2];
+    uint32_t random = 1;
+    for (int i = 0; i < sourceFrames * 2; ++i) {
+        random = random * 1664525 + 1013904223;
+        source[i] = int16_t(random >> 18) - 8192;
+    }
+    int16_t *chunk = new int16_t[chunkFrames * 2];
+
+    LoudnessNormalizer normalizer(chunkFrames * 2);
+    normalizer.setEnabled(true);
+    normalizer.setTargetLoudness(-14);
+    normalizer.startTrack(LoudnessNormalizer::UnknownLoudness);
+    Crossfader crossfader(fadeFrames * 2);
+    for (int i = 0; i < fadeFrames * 2; ++i) {
+        crossfader.tailBuffer()[i] = source[i % (sourceFrames * 2)];
+    }
+    Equalizer equalizer;
+    Equalizer::Band bands[10];
+    for (int i = 0; i < 10; ++i) {
+        bands[i].type = Equalizer::Peaking;
+        bands[i].frequency = 31.25 * (1 << i);
+        bands[i].gain = i % 2 ? 3 : -3;
+        bands[i].q = 1.4;
+    }
+    equalizer.setBands(true, bands, 10);
+    GainNode gain(0.5f);
+    PeakMeter meter;
+
+    AudioGraph graph;
+    graph.addNode(&gain);
+    graph.addNode(&normalizer);
+    graph.addNode(&crossfader);
+    graph.addNode(&equalizer);
+    graph.addNode(&meter);
+    graph.setFormat(44100, 2);
+
+    StatsReader reader;
+    reader.graph = &graph;
+    reader.chunkFrames = chunkFrames;
+    reader.consistent = true;
+    reader.reads = 0;
+    FunctionThread readerThread(readStats, &reader);
+    readerThread.start();
+
+    int fades = 0;
+    qint64 frames = 0;
+    const qint64 start = PlaybackClock::now();
+    while (frames < totalFrames) {
+        if (!crossfader.isFading() && frames % (fadeFrames * 3) < chunkFrames) {
+            crossfader.begin(fadeFrames, 2);
+            ++fades;
+        }
+        for (int i = 0; i < chunkFrames * 2; ++i) {
+            chunk[i] = source[(frames * 2 + i) % (sourceFrames * 2)];
+        }
+        graph.process(chunk, chunkFrames);
+        frames += chunkFrames;
+    }
+    const qint64 elapsed = PlaybackClock::now() - start;
+    reader.done.fetchAndStoreRelease(1);
+    readerThread.wait();
+
+    printf("graph: %d nodes, %lld s of audio in %.2f s, %.2f ns/frame, %d compilations\n",
+           graph.nodeCount(), qint64(seconds), elapsed / 1e6, elapsed * 1000.0 / frames, graph.compilations());
+    for (int i = 0; i < graph.nodeCount(); ++i) {
+        const AudioGraph::NodeStats stats = graph.nodeStats(i);
+        printf("graph:   %-12s %6.2f ns/frame over %lld frames\n", stats.name,
+               stats.frames ? stats.microseconds * 1000.0 / stats.frames : 0.0, stats.frames);
+    }
+
+    check(graph.nodeStats(0).frames == frames, "graph", "frames missing from the statistics");
+    check(graph.nodeStats(2).frames < frames, "graph", "inactive crossfader was scheduled");
+    check(graph.compilations() <= 2 * fades + 2, "graph", "schedule compiled when nothing changed");
+    check(meter.peak() > 0 && meter.peak() < 4, "graph", "output level is off");
+    check(reader.consistent, "graph", "torn statistics read");
+
+    delete[] source;
+    delete[] chunk;
+}
+//END: graph
+
+//BEGIN: commands
+namespace {
+
+// How long the sink takes to have room for another period: 1024 frames at
+// 44.1 kHz, as with the null sink
+const int PeriodMicroseconds = 23220;
+
+struct CommandRun {
+    bool               lockFree;
+    QAtomicInt         done;
+
+    // Lock-free path
+    FeederCommandQueue queue;
+    QVector<qint64>    effect;
+
+    // What it replaced: the feeder holds the mutex while it writes, and
+    // waits on a condition while paused
+    QMutex             mutex;
+    QWaitCondition     resumed;
+    bool               paused;
+};
+
+void commandFeeder(void *argument)
+{
+    CommandRun *run = static_cast<CommandRun*>(argument);
+    bool paused = false;
+    while (!run->done.fetchAndAddAcquire(0)) {
+        if (run->lockFree) {
+            FeederCommandQueue::Command command;
+            while (run->queue.take(&command)) {
+                run->effect.append(PlaybackClock::now() - command.posted);
+                if (command.type == FeederCommandQueue::Pause) {
+                    paused = true;
+                } else if (command.type == FeederCommandQueue::Resume) {
+                    paused = false;
+                }
+            }
+            if (paused) {
+                run->queue.wait(100);
+            } else {
+                usleep(PeriodMicroseconds);
+            }
+        } else {
+            QMutexLocker locker(&run->mutex);
+            if (run->paused) {
+                run->resumed.wait(&run->mutex);
+            } else {
+                usleep(PeriodMicroseconds);
+            }
+        }
+    }
+}
+
+}
+
+// Pause, resume, seek and stop clicked at random intervals while the
+// feeder is writing, through the command queue and through the mutex it
+// replaced. Reports how long the click handler is held up and how long
+// the feeder takes to act on it.
+static void benchmarkCommands()
+{
+    const int commands = s_quick ? 40 : 1000;
+    const FeederCommandQueue::Type types[] = {
+        FeederCommandQueue::Pause,
+        FeederCommandQueue::Resume,
+        FeederCommandQueue::Seek,
+        FeederCommandQueue::Stop
+    };
+
+    for (int path = 0; path < 2; ++path) {
+        CommandRun run;
+        run.lockFree = path == 0;
+        run.paused = false;
+        run.effect.reserve(commands);
+
+        QVector<qint64> stalls;
+        stalls.reserve(commands);
+        uint32_t random = 1;
+
+        FunctionThread feeder(commandFeeder, &run);
+        feeder.start();
+        for (int i = 0; i < commands; ++i) {
+            random = random * 1664525 + 1013904223;
+            usleep(2000 + (random >> 8) % 6000);
+            const FeederCommandQueue::Type type = types[i % 4];
+            const qint64 clicked = PlaybackClock::now();
+            if (run.lockFree) {
+                check(run.queue.post(type), "commands", "queue full");
+            } else {
+                QMutexLocker locker(&run.mutex);
+                if (type == FeederCommandQueue::Pause) {
+                    run.paused = true;
+                } else if (type == FeederCommandQueue::Resume) {
+                    run.paused = false;
+                    run.resumed.wakeAll();
+                }
+                // Took effect as soon as the lock was taken
+                run.effect.append(PlaybackClock::now() - clicked);
+            }
+            stalls.append(PlaybackClock::now() - clicked);
+        }
+        // Let the feeder take what is left, then stop it
+        usleep(PeriodMicroseconds * 2);
+        run.done.fetchAndStoreRelease(1);
+        {
+            QMutexLocker locker(&run.mutex);
+            run.paused = false;
+            run.resumed.wakeAll();
+        }
+        run.queue.wakeUp();
+        feeder.wait();
+
+        qSort(stalls.begin(), stalls.end());
+        qSort(run.effect.begin(), run.effect.end());
+        const char *name = run.lockFree ? "queue" : "mutex";
+        printf("commands: %-5s click handler p50 %5lld us, p99 %5lld us, max %5lld us\n", name,
+               percentile(stalls, 50), percentile(stalls, 99), stalls.last());
+        printf("commands: %-5s click to effect p50 %5lld us, p99 %5lld us, max %5lld us\n", name,
+               percentile(run.effect, 50), percentile(run.effect, 99),
+               run.effect.isEmpty() ? 0LL : run.effect.last());
+        check(run.effect.count() == commands, "commands", "commands lost");
+    }
+}
+//END: commands
+
+//BEGIN: fft
+namespace {
+
+/**
+ * The recursive Hartley transform FHT did before RealFFT took over, after
+ * Melchior Franz's fht.cpp, kept to compare against.
+ */
+class RecursiveHartley
+{
+public:
+    RecursiveHartley(int exp2)
+        : m_num(1 << exp2)
+        , m_buf(new float[m_num])
+        , m_tab(new float[m_num * 2])
+    {
+        float *costab = m_tab;
+        float *sintab = m_tab + m_num / 2 + 1;
+        for (int i = 0; i < m_num; ++i) {
+            *costab = *sintab = cos(M_PI * i / (m_num / 2));
+            costab += 2;
+            sintab += 2;
+            if (sintab > m_tab + m_num * 2) {
+                sintab = m_tab + 1;
+            }
+        }
+    }
+
+    ~RecursiveHartley()
+    {
+        delete[] m_buf;
+        delete[] m_tab;
+    }
+
+    void transform(float *p)
+    {
+        transform(p, m_num, 0);
+    }
+
+private:
+    void transform8(float *p)
+    {
+        const float a = p[0], b = p[1], c = p[2], d = p[3];
+        const float e = p[4], f = p[5], g = p[6], h = p[7];
+        const float b_f2 = (b - f) * M_SQRT2;
+        const float d_h2 = (d - h) * M_SQRT2;
+        const float a_c_eg = a - c - e + g;
+        const float a_ce_g = a - c + e - g;
+        const float ac_e_g = a + c - e - g;
+        const float aceg = a + c + e + g;
+        const float b_df_h = b - d + f - h;
+        const float bdfh = b + d + f + h;
+        p[0] = aceg + bdfh;
+        p[1] = ac_e_g + b_f2;
+        p[2] = a_ce_g + b_df_h;
+        p[3] = a_c_eg + d_h2;
+        p[4] = aceg - bdfh;
+        p[5] = ac_e_g - b_f2;
+        p[6] = a_ce_g - b_df_h;
+        p[7] = a_c_eg - d_h2;
+    }
+
+    void transform(float *p, int n, int k)
+    {
+        if (n == 8) {
+            transform8(p + k);
+            return;
+        }
+
+        const int ndiv2 = n / 2;
+        for (int i = 0; i < ndiv2; ++i) {
+            m_buf[i] = p[k + 2 * i];
+            m_buf[ndiv2 + i] = p[k + 2 * i + 1];
+        }
+        memcpy(p + k, m_buf, sizeof(float) * n);
+
+        transform(p, ndiv2, k);
+        transform(p, ndiv2, k + ndiv2);
+
+        const int j = m_num / ndiv2 - 1;
+        const float *ptab = m_tab;
+        const float *t3 = p + k + ndiv2;
+        const float *t4 = p + k + n;
+        const float *pp = p + k;
+
+        float a = *ptab++ * *t3++;
+        a += *ptab * *pp;
+        ptab += j;
+        m_buf[0] = *pp + a;
+        m_buf[ndiv2] = *pp++ - a;
+        for (int i = 1; i < ndiv2; ++i, ptab += j) {
+            a = *ptab++ * *t3++;
+            a += *ptab * *--t4;
+            m_buf[i] = *pp + a;
+            m_buf[ndiv2 + i] = *pp++ - a;
+        }
+        memcpy(p + k, m_buf, sizeof(float) * n);
+    }
+
+    const int m_num;
+    float    *m_buf;
+    float    *m_tab;
+};
+
+/**
+ * Nanoseconds per call of @p transform on @p size values, with fresh input
+ * every time and the cost of copying it taken out.
+ */
+template<typename Transform>
+double timeTransform(Transform &transform, const float *input, float *data, int size)
+{
+    const int repetitions = qMax((s_quick ? 1 << 20 : 1 << 24) / size, 16);
+
+    qint64 start = PlaybackClock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        memcpy(data, input, size * sizeof(float));
+        __asm__ __volatile__("" : : "r"(data) : "memory");
+    }
+    const qint64 copying = PlaybackClock::now() - start;
+
+    start = PlaybackClock::now();
+    for (int i = 0; i < repetitions; ++i) {
+        memcpy(data, input, size * sizeof(float));
+        transform.transform(data);
+    }
+    const qint64 elapsed = PlaybackClock::now() - start - copying;
+    return qMax(elapsed, qint64(0)) * 1000.0 / repetitions;
+}
+
+}
+
+// RealFFT and the Hartley transform FHT now derives from it, against the
+// recursive FHT, from 2^3 to 2^12 values. The results are checked against
+// a DFT done the slow way in double precision.
+static void benchmarkFft()
+{
+    for (int exp2 = 3; exp2 <= 12; ++exp2) {
+        const int size = 1 << exp2;
+        float *input = new float[size];
+        float *data = new float[size];
+        double *re = new double[size];
+        double *im = new double[size];
+
+        uint32_t random = exp2;
+        for (int i = 0; i < size; ++i) {
+            random = random * 1664525 + 1013904223;
+            input[i] = int32_t(random) / 2147483648.0f;
+        }
+
+        double scale = 0;
+        for (int k = 0; k < size; ++k) {
+            re[k] = im[k] = 0;
+            for (int i = 0; i < size; ++i) {
+                const double angle = 2 * M_PI * (qint64(i) * k % size) / size;
+                re[k] += input[i] * cos(angle);
+                im[k] -= input[i] * sin(angle);
+            }
+            scale = qMax(scale, qMax(qAbs(re[k]), qAbs(im[k])));
+        }
+        const double tolerance = scale * 1e-5 * exp2;
+
+        RealFFT fft(exp2);
+        memcpy(data, input, size * sizeof(float));
+        fft.transform(data);
+        double error = qMax(qAbs(data[0] - re[0]), qAbs(data[1] - re[size / 2]));
+        for (int k = 1; k < size / 2; ++k) {
+            error = qMax(error, qMax(qAbs(data[2 * k] - re[k]), qAbs(data[2 * k + 1] - im[k])));
+        }
+        check(error < tolerance, "fft", "RealFFT differs from the DFT");
+
+        FHT fht(exp2);
+        memcpy(data, input, size * sizeof(float));
+        fht.transform(data);
+        error = 0;
+        for (int k = 0; k < size; ++k) {
+            error = qMax(error, qAbs(data[k] - (re[k] - im[k])));
+        }
+        check(error < tolerance, "fft", "FHT differs from the Hartley transform");
+
+        RecursiveHartley recursive(exp2);
+        memcpy(data, input, size * sizeof(float));
+        recursive.transform(data);
+        error = 0;
+        for (int k = 0; k < size; ++k) {
+            error = qMax(error, qAbs(data[k] - (re[k] - im[k])));
+        }
+        check(error < tolerance, "fft", "recursive FHT differs from the Hartley transform");
+
+        const double recursiveTime = timeTransform(recursive, input, data, size);
+        const double fhtTime = timeTransform(fht, input, data, size);
+        const double fftTime = timeTransform(fft, input, data, size);
+        printf("fft: 2^%-2d recursive FHT %9.1f ns, FHT %9.1f ns, RealFFT %9.1f ns (%4.1fx)\n",
+               exp2, recursiveTime, fhtTime, fftTime, recursiveTime / qMax(fftTime, 0.1));
+
+        delete[] input;
+        delete[] data;
+        delete[] re;
+        delete[] im;
+    }
+    printf("fft: using %s\n", AudioKernels::instructionSet());
+}
+//END: fft
+
+//BEGIN: allocations
+// Counts allocations, and leaves freeing to the default operator delete,
+// which frees what malloc() gave
+static QAtomicInt s_allocations;
+
+static void *allocate(size_t size)
+{
+    s_allocations.ref();
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+namespace {
+
+/**
+ * The spectrum side of Analyzer::Base::processChunk(), which as a widget
+ * cannot be built here: the same calls on buffers sized once, at the
+ * BlockAnalyzer size of 2^9.
+ */
+class SpectrumFrames
+{
+public:
+    SpectrumFrames()
+        : m_fht(9)
+        , m_size(m_fht.size())
+        , m_history(new float[m_size])
+        , m_window(new float[m_size])
+        , m_input(new float[m_size])
+        , m_fhtBuffer(new float[m_size])
+        , m_spectrum(new float[m_size / 2])
+        , m_historyPos(0)
+        , m_sinceHop(0)
+        , m_spectra(0)
+    {
+        memset(m_history, 0, m_size * sizeof(float));
+        for (int i = 0; i < m_size; ++i) {
+            m_window[i] = 1 - cos(2 * M_PI * i / m_size);
+        }
+    }
+
+    ~SpectrumFrames()
+    {
+        delete[] m_history;
+        delete[] m_window;
+        delete[] m_input;
+        delete[] m_fhtBuffer;
+        delete[] m_spectrum;
+    }
+
+    int spectra() const
+    {
+        return m_spectra;
+    }
+
+    void process(const Chunk &chunk)
+    {
+        const int hop = m_size / 2;
+        const int16_t *const data = chunk.m_block.data();
+        for (int done = 0; done < chunk.m_dataFrames; ) {
+            const int frames = qMin(qMin(chunk.m_dataFrames - done, m_size - m_historyPos), hop - m_sinceHop);
+            AudioKernels::downmixToFloat(data + done * chunk.m_channels, m_history + m_historyPos, frames, chunk.m_channels);
+            m_historyPos = (m_historyPos + frames) % m_size;
+            m_sinceHop += frames;
+            done += frames;
+            if (m_sinceHop == hop) {
+                m_sinceHop = 0;
+                spectrum();
+            }
+        }
+    }
+
+private:
+    void spectrum()
+    {
+        const int older = m_size - m_historyPos;
+        for (int x = 0; x < older; ++x) {
+            m_input[x] = m_history[m_historyPos + x] * m_window[x];
+        }
+        for (int x = older; x < m_size; ++x) {
+            m_input[x] = m_history[x - older] * m_window[x];
+        }
+        m_fht.copy(m_fhtBuffer, m_input);
+        m_fht.logSpectrum(m_input, m_fhtBuffer);
+        m_fht.scale(m_input, 1.0 / 20);
+        m_fht.ewma(m_spectrum, m_input, 0.5);
+        ++m_spectra;
+    }
+
+    FHT    m_fht;
+    int    m_size;
+    float *m_history;
+    float *m_window;
+    float *m_input;
+    float *m_fhtBuffer;
+    float *m_spectrum;
+    int    m_historyPos;
+    int    m_sinceHop;
+    int    m_spectra;
+};
+
+}
+
+// Chunks go from the pool through the spectrum tap into spectra the way
+// the feeder and the spectrum thread pass them; once warmed up, none of
+// that may allocate
+static void benchmarkAllocations()
+{
+    const int blockSamples = 8192;
+    const int chunks = s_quick ? 1000 : 100000;
+    const int warmUp = 16;
+
+    PcmBlockPool pool(blockSamples, 8);
+    SpectrumTap tap;
+    SpectrumFrames frames;
+
+    uint32_t random = 1;
+    int allocations = 0;
+    qint64 elapsed = 0;
+    for (int i = 0; i < warmUp + chunks; ++i) {
+        if (i == warmUp) {
+            allocations = s_allocations.fetchAndAddAcquire(0);
+            elapsed = PlaybackClock::now();
+        }
+        Chunk chunk;
+        chunk.m_block = pool.acquire();
+        chunk.m_dataFrames = 2048;
+        chunk.m_rate = 44100;
+        chunk.m_channels = 2;
+        int16_t *data = chunk.m_block.data();
+        for (int j = 0; j < chunk.m_dataFrames * 2; ++j) {
+            random = random * 1664525 + 1013904223;
+            data[j] = int16_t(random >> 16);
+        }
+        tap.push(chunk);
+        chunk = Chunk();
+
+        Chunk taken;
+        while (tap.take(&taken)) {
+            frames.process(taken);
+        }
+    }
+    allocations = s_allocations.fetchAndAddAcquire(0) - allocations;
+    elapsed = PlaybackClock::now() - elapsed;
+
+    const PcmBlockPool::Stats stats = pool.stats();
+    printf("allocations: %d in %d chunks, %d spectra (%.1f us per chunk); pool: %d blocks, %d from the heap, %d in use\n",
+           allocations, chunks, frames.spectra(), double(elapsed) / chunks,
+           stats.blocks, stats.heapAllocations, stats.inUse);
+    // Setting up did allocate, or nothing is being counted
+    check(s_allocations.fetchAndAddAcquire(0) > 0, "allocations", "allocations are not counted");
+    check(allocations == 0, "allocations", "the frame path allocates");
+    check(stats.heapAllocations == 0, "allocations", "the pool ran out of blocks");
+    check(stats.inUse == 0, "allocations", "blocks were not given back");
+}
+//END: allocations
+
+//BEGIN: blocks
+namespace {
+
+// Bars jump up at random and fall, leaving fade bars behind, as
+// BlockAnalyzer::animate() moves them at 60 frames per second: a fall of
+// about half a row, and a fade step every fifth frame
+void moveColumns(std::vector<BlockCanvas::Column> &columns, std::vector<float> &store,
+                 int rows, int frame, uint32_t &random)
+{
+    const float fall = 16.0f / 30;
+    for (unsigned int x = 0; x < columns.size(); ++x) {
+        BlockCanvas::Column &c = columns[x];
+        random = random * 1664525 + 1013904223;
+        if ((random >> 29) == 0) {
+            store[x] = qMin(store[x], float((random >> 8) % (rows + 1)));
+        } else {
+            store[x] = qMin(store[x] + fall, float(rows));
+        }
+        c.bar = c.top = int(store[x]);
+        if (c.bar < rows && (c.fadePos < 0 || c.bar <= c.fadePos)) {
+            c.fadePos = c.bar;
+            c.fade = BlockCanvas::FadeSize;
+        } else if (c.fade > 0 && frame % 5 == 0 && !--c.fade) {
+            c.fadePos = -1;
+        }
+    }
+}
+
+}
+
+// BlockCanvas 20 rows high at 32, 128 and 256 columns: drawing what
+// changed, then copying the image out as BlockAnalyzer::paintEvent() does.
+// The image has to come out the same as one drawn in one go.
+static void benchmarkBlocks()
+{
+    const int columnCounts[] = { 32, 128, 256 };
+    const int frames = s_quick ? 300 : 20000;
+    const int height = 60;
+    const int rows = (height + 1) / (BlockCanvas::BlockHeight + 1);
+    const int y = (height - rows * (BlockCanvas::BlockHeight + 1) + 2) / 2;
+
+    std::vector<QRgb> bars(rows);
+    for (int i = 0; i < rows; ++i) {
+        bars[i] = QColor(255 - i * 8, 128 + i * 4, 64).rgb();
+    }
+
+    for (unsigned int n = 0; n < sizeof(columnCounts) / sizeof(int); ++n) {
+        const int columns = columnCounts[n];
+        const int width = columns * (BlockCanvas::BlockWidth + 1) - 1;
+
+        BlockCanvas canvas;
+        canvas.resize(width, height, rows, y, columns);
+        canvas.setColors(QColor(32, 32, 32).rgb(), QColor(28, 28, 28).rgb(), QColor(255, 255, 255).rgb(),
+                         bars, QColor(28, 28, 28), QColor(20, 60, 40));
+        QImage target(width, height, QImage::Format_RGB32);
+
+        std::vector<BlockCanvas::Column> shown(columns);
+        std::vector<float> store(columns, rows);
+        for (int x = 0; x < columns; ++x) {
+            shown[x].bar = shown[x].top = rows;
+            shown[x].fadePos = -1;
+            shown[x].fade = 0;
+        }
+        canvas.draw(&shown[0], columns);
+
+        uint32_t random = columns;
+        qint64 drawing = 0;
+        qint64 copying = 0;
+        qint64 drawn = 0;
+        for (int i = 0; i < frames; ++i) {
+            moveColumns(shown, store, rows, i, random);
+            const qint64 start = PlaybackClock::now();
+            drawn += canvas.draw(&shown[0], columns);
+            const qint64 painted = PlaybackClock::now();
+            QPainter p(&target);
+            p.drawImage(0, 0, canvas.image());
+            copying += PlaybackClock::now() - painted;
+            drawing += painted - start;
+        }
+
+        check(canvas.draw(&shown[0], columns) == 0, "blocks", "unchanged columns were drawn again");
+
+        // What drawing every column every frame would cost
+        qint64 start = PlaybackClock::now();
+        for (int i = 0; i < frames; ++i) {
+            canvas.setColors(QColor(32, 32, 32).rgb(), QColor(28, 28, 28).rgb(), QColor(255, 255, 255).rgb(),
+                             bars, QColor(28, 28, 28), QColor(20, 60, 40));
+            canvas.draw(&shown[0], columns);
+        }
+        const qint64 redrawing = PlaybackClock::now() - start;
+
+        BlockCanvas reference;
+        reference.resize(width, height, rows, y, columns);
+        reference.setColors(QColor(32, 32, 32).rgb(), QColor(28, 28, 28).rgb(), QColor(255, 255, 255).rgb(),
+                            bars, QColor(28, 28, 28), QColor(20, 60, 40));
+        reference.draw(&shown[0], columns);
+        check(canvas.image() == reference.image(), "blocks", "changed columns were not all drawn");
+
+        printf("blocks: %3d columns %6.2f us/frame painting %5.1f columns (%6.2f us redrawing all), %6.2f us copying out\n",
+               columns, double(drawing) / frames, double(drawn) / frames, double(redrawing) / frames,
+               double(copying) / frames);
+    }
+}
+//END: blocks
+
+struct Section {
+    const char *name;
+    void (*run)();
+};
+
+static const Section s_sections[] = {
+    { "ring", benchmarkRing },
+    { "markers", benchmarkMarkers },
+    { "resampler", benchmarkResampler },
+    { "equalizer", benchmarkEqualizer },
+    { "graph", benchmarkGraph },
+    { "commands", benchmarkCommands },
+    { "fft", benchmarkFft },
+    { "allocations", benchmarkAllocations },
+    { "blocks", benchmarkBlocks }
+};
+
+static const int s_sectionCount = sizeof(s_sections) / sizeof(Section);
+
+int main(int argc, char **argv)
+{
+    QVector<const Section*> selected;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--quick")) {
+            s_quick = true;
+            continue;
+        }
+        int j = 0;
+        while (j < s_sectionCount && strcmp(argv[i], s_sections[j].name)) {
+            ++j;
+        }
+        if (j == s_sectionCount) {
+            fprintf(stderr, "usage: %s [--quick] [section...]\nsections:", argv[0]);
+            for (j = 0; j < s_sectionCount; ++j) {
+                fprintf(stderr, " %s", s_sections[j].name);
+            }
+            fprintf(stderr, "\n");
+            return 2;
+        }
+        selected.append(&s_sections[j]);
+    }
+    if (selected.isEmpty()) {
+        for (int i = 0; i < s_sectionCount; ++i) {
+            selected.append(&s_sections[i]);
+        }
+    }
+
+    for (int i = 0; i < selected.count(); ++i) {
+        selected[i]->run();
+    }
+
+    if (s_failures) {
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
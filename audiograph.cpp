@@ -0,0 +1,159 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audiograph.h"
+#include "audionode.h"
+#include "audiokernels.h"
+
+#include <time.h>
+
+static inline qint64 nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+AudioGraph::AudioGraph()
+    : m_nodeCount(0)
+    , m_channels(2)
+    , m_block(new float[BlockFrames * MaxChannels])
+    , m_scheduleLength(0)
+    , m_compiledNodes(0)
+    , m_sequence(0)
+    , m_compilations(0)
+{
+    for (int i = 0; i < MaxNodes; ++i) {
+        m_nanoseconds[i] = 0;
+        m_frames[i] = 0;
+        m_microseconds[i] = 0;
+    }
+}
+
+AudioGraph::~AudioGraph()
+{
+    delete[] m_block;
+}
+
+void AudioGraph::addNode(AudioNode *node)
+{
+    Q_ASSERT(m_nodeCount < MaxNodes);
+    m_nodes[m_nodeCount++] = node;
+    node->setFormat(44100, m_channels);
+}
+
+void AudioGraph::setFormat(int sampleRate, int channels)
+{
+    m_channels = channels;
+    for (int i = 0; i < m_nodeCount; ++i) {
+        m_nodes[i]->setFormat(sampleRate, channels);
+    }
+}
+
+void AudioGraph::reset()
+{
+    for (int i = 0; i < m_nodeCount; ++i) {
+        m_nodes[i]->reset();
+    }
+}
+
+void AudioGraph::process(int16_t *data, int frames, const AudioNode *until)
+{
+    if (m_channels > MaxChannels) {
+        return;
+    }
+
+    int end = 0;
+    while (end < m_nodeCount && m_nodes[end] != until) {
+        ++end;
+    }
+
+    int processed[MaxNodes] = { 0 };
+    for (int done = 0; done < frames; ) {
+        // Nodes come and go as fades end or filters settle
+        quint32 activeNodes = 0;
+        for (int i = 0; i < m_nodeCount; ++i) {
+            if (m_nodes[i]->isActive()) {
+                activeNodes |= 1 << i;
+            }
+        }
+        if (activeNodes != m_compiledNodes) {
+            compile(activeNodes);
+        }
+        if (!(activeNodes & ((1 << end) - 1))) {
+            break;
+        }
+
+        const int length = qMin(frames - done, int(BlockFrames));
+        int16_t *const samples = data + done * m_channels;
+        AudioKernels::int16ToFloat(samples, m_block, length * m_channels);
+        for (int i = 0; i < m_scheduleLength && m_schedule[i] < end; ++i) {
+            const int node = m_schedule[i];
+            const qint64 start = nanoseconds();
+            m_nodes[node]->process(m_block, length);
+            m_nanoseconds[node] += nanoseconds() - start;
+            processed[node] += length;
+        }
+        AudioKernels::floatToInt16(m_block, samples, length * m_channels);
+        done += length;
+    }
+
+    m_sequence.fetchAndAddOrdered(1);
+    for (int i = 0; i < end; ++i) {
+        if (processed[i]) {
+            m_frames[i] += processed[i];
+            m_microseconds[i] = m_nanoseconds[i] / 1000;
+        }
+    }
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+int AudioGraph::nodeCount() const
+{
+    return m_nodeCount;
+}
+
+AudioGraph::NodeStats AudioGraph::nodeStats(int node) const
+{
+    NodeStats stats;
+    stats.name = m_nodes[node]->name();
+    int sequence;
+    do {
+        sequence = m_sequence.fetchAndAddAcquire(0);
+        stats.frames = m_frames[node];
+        stats.microseconds = m_microseconds[node];
+    } while ((sequence & 1) || m_sequence.fetchAndAddOrdered(0) != sequence);
+    return stats;
+}
+
+int AudioGraph::compilations() const
+{
+    return m_compilations;
+}
+
+void AudioGraph::compile(quint32 activeNodes)
+{
+    m_scheduleLength = 0;
+    for (int i = 0; i < m_nodeCount; ++i) {
+        if (activeNodes & (1 << i)) {
+            m_schedule[m_scheduleLength++] = i;
+        }
+    }
+    m_compiledNodes = activeNodes;
+    m_compilations.ref();
+}
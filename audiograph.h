@@ -0,0 +1,101 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIOGRAPH_H
+#define AUDIOGRAPH_H
+
+#include <QtCore/QAtomicInt>
+
+#include <stdint.h>
+
+class AudioNode;
+
+/**
+ * Runs the sound feeder's processing nodes, in the order they were added,
+ * between the ring and the sink.
+ *
+ * Audio is converted to float once, goes through the nodes in place in
+ * blocks of BlockFrames (small enough to stay in L1 cache from one node to
+ * the next) and is converted back once. The schedule, the list of nodes
+ * that are active, is compiled again only when that set changes; with no
+ * node active nothing is converted at all.
+ */
+class AudioGraph
+{
+public:
+    static const int BlockFrames = 256;
+    static const int MaxChannels = 8;
+    static const int MaxNodes = 8;
+
+    struct NodeStats {
+        const char *name;
+        qint64 frames;        ///< frames processed while active
+        qint64 microseconds;  ///< CPU time spent processing them
+    };
+
+    AudioGraph();
+    ~AudioGraph();
+
+    /**
+     * Appends @p node, which is not owned. Nodes are added once, before
+     * any processing.
+     */
+    void addNode(AudioNode *node);
+
+    void setFormat(int sampleRate, int channels);
+    void reset();
+
+    /**
+     * Processes @p frames of interleaved @p data in place, through all
+     * active nodes or only those before @p until.
+     */
+    void process(int16_t *data, int frames, const AudioNode *until = 0);
+
+    int nodeCount() const;
+    NodeStats nodeStats(int node) const;
+
+    /**
+     * Times the schedule has been compiled.
+     */
+    int compilations() const;
+
+private:
+    void compile(quint32 activeNodes);
+
+    AudioNode         *m_nodes[MaxNodes];
+    int                m_nodeCount;
+    int                m_channels;
+    float             *m_block;
+
+    // Indexes of the active nodes, in order
+    int                m_schedule[MaxNodes];
+    int                m_scheduleLength;
+    quint32            m_compiledNodes;
+
+    // Only touched by the processing thread
+    qint64             m_nanoseconds[MaxNodes];
+
+    // Written by the processing thread after every process(), the time
+    // rounded down to microseconds. Seqlock: odd while being updated.
+    mutable QAtomicInt m_sequence;
+    qint64             m_frames[MaxNodes];
+    qint64             m_microseconds[MaxNodes];
+    mutable QAtomicInt m_compilations;
+};
+
+#endif
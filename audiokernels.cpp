@@ -0,0 +1,571 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audiokernels.h"
+
+#include <QtCore/QtGlobal>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIOKERNELS_X86
+#include <immintrin.h>
+#endif
+
+//BEGIN: scalar kernels
+static void int16ToFloatScalar(const int16_t *in, float *out, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = in[i] * (1.0f / 32768.0f);
+    }
+}
+
+static void floatToInt16Scalar(const float *in, int16_t *out, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const float value = in[i] * 32768.0f;
+        if (value >= 32767.0f) {
+            out[i] = 32767;
+        } else if (value <= -32768.0f) {
+            out[i] = -32768;
+        } else {
+            out[i] = int16_t(value < 0 ? value - 0.5f : value + 0.5f);
+        }
+    }
+}
+
+static void downmixToFloatScalar(const int16_t *in, float *out, int frames, int channels)
+{
+    const float scale = 1.0f / (32768.0f * channels);
+    for (int frame = 0; frame < frames; ++frame, in += channels) {
+        int sum = 0;
+        for (int channel = 0; channel < channels; ++channel) {
+            sum += in[channel];
+        }
+        out[frame] = sum * scale;
+    }
+}
+
+static float dotProductScalar(const float *a, const float *b, int count)
+{
+    float sum = 0;
+    for (int i = 0; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void mixRampedScalar(const float *a, float gainA, float stepA,
+                            const float *b, float gainB, float stepB,
+                            float *out, int frames, int channels)
+{
+    for (int frame = 0; frame < frames; ++frame) {
+        const float ga = gainA + stepA * frame;
+        const float gb = gainB + stepB * frame;
+        for (int channel = 0; channel < channels; ++channel) {
+            const int i = frame * channels + channel;
+            out[i] = a[i] * ga + b[i] * gb;
+        }
+    }
+}
+
+static void biquadCascadeScalar(float *data, int frames, int channels,
+                                const float *coefficients, float *state, int stages)
+{
+    for (int stage = 0; stage < stages; ++stage) {
+        const float *const c = coefficients + stage * 5;
+        float *const s = state + stage * 2 * channels;
+        for (int channel = 0; channel < channels; ++channel) {
+            float s1 = s[channel];
+            float s2 = s[channels + channel];
+            float *sample = data + channel;
+            for (int i = 0; i < frames; ++i, sample += channels) {
+                const float x = *sample;
+                const float y = c[0] * x + s1;
+                s1 = c[1] * x - c[3] * y + s2;
+                s2 = c[2] * x - c[4] * y;
+                *sample = y;
+            }
+            s[channel] = s1;
+            s[channels + channel] = s2;
+        }
+    }
+}
+
+static void fftStageScalar(float *re, float *im, const float *wr, const float *wi, int length, int half)
+{
+    for (int start = 0; start < length; start += 2 * half) {
+        float *const ar = re + start;
+        float *const ai = im + start;
+        float *const br = ar + half;
+        float *const bi = ai + half;
+        for (int j = 0; j < half; ++j) {
+            const float tr = br[j] * wr[j] - bi[j] * wi[j];
+            const float ti = br[j] * wi[j] + bi[j] * wr[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+//END: scalar kernels
+
+#ifdef AUDIOKERNELS_X86
+//BEGIN: SSE2 kernels
+__attribute__((target("sse2")))
+static void int16ToFloatSse2(const int16_t *in, float *out, int count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Sign extend by unpacking into the high half and shifting back down
+        const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void floatToInt16Sse2(const float *in, int16_t *out, int count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // cvtps rounds to nearest, packs saturates to the int16 range
+        const __m128i low = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        const __m128i high = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+    floatToInt16Scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void downmixToFloatSse2(const int16_t *in, float *out, int frames, int channels)
+{
+    if (channels == 1) {
+        int16ToFloatSse2(in, out, frames);
+        return;
+    }
+    if (channels != 2) {
+        downmixToFloatScalar(in, out, frames, channels);
+        return;
+    }
+
+    // madd against ones adds left and right of each frame into 32 bits
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+    int frame = 0;
+    for (; frame + 4 <= frames; frame += 4) {
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + frame * 2));
+        const __m128i sums = _mm_madd_epi16(samples, ones);
+        _mm_storeu_ps(out + frame, _mm_mul_ps(_mm_cvtepi32_ps(sums), scale));
+    }
+    downmixToFloatScalar(in + frame * 2, out + frame, frames - frame, 2);
+}
+
+__attribute__((target("sse2")))
+static float dotProductSse2(const float *a, const float *b, int count)
+{
+    __m128 sum = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum) + dotProductScalar(a + i, b + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void mixRampedSse2(const float *a, float gainA, float stepA,
+                          const float *b, float gainB, float stepB,
+                          float *out, int frames, int channels)
+{
+    if (channels > 2) {
+        mixRampedScalar(a, gainA, stepA, b, gainB, stepB, out, frames, channels);
+        return;
+    }
+
+    // Frame of each of the 4 samples handled per iteration
+    const __m128 offset = channels == 1 ? _mm_setr_ps(0, 1, 2, 3) : _mm_setr_ps(0, 0, 1, 1);
+    const __m128 vGainA = _mm_set1_ps(gainA);
+    const __m128 vStepA = _mm_set1_ps(stepA);
+    const __m128 vGainB = _mm_set1_ps(gainB);
+    const __m128 vStepB = _mm_set1_ps(stepB);
+
+    const int count = frames * channels;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 frame = _mm_add_ps(_mm_set1_ps(i / channels), offset);
+        const __m128 mixed = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), _mm_add_ps(vGainA, _mm_mul_ps(vStepA, frame))),
+                                        _mm_mul_ps(_mm_loadu_ps(b + i), _mm_add_ps(vGainB, _mm_mul_ps(vStepB, frame))));
+        _mm_storeu_ps(out + i, mixed);
+    }
+
+    const int frame = i / channels;
+    mixRampedScalar(a + i, gainA + stepA * frame, stepA, b + i, gainB + stepB * frame, stepB,
+                    out + i, frames - frame, channels);
+}
+
+struct BiquadSse2 {
+    __m128 b0, b1, b2, a1, a2;
+};
+
+__attribute__((target("sse2")))
+static inline __m128 biquadStepSse2(const BiquadSse2 &c, __m128 x, __m128 &s1, __m128 &s2)
+{
+    const __m128 y = _mm_add_ps(_mm_mul_ps(c.b0, x), s1);
+    s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c.b1, x), _mm_mul_ps(c.a1, y)), s2);
+    s2 = _mm_sub_ps(_mm_mul_ps(c.b2, x), _mm_mul_ps(c.a2, y));
+    return y;
+}
+
+__attribute__((target("sse2")))
+static inline __m128 selectSse2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void biquadCascadeSse2(float *data, int frames, int channels,
+                              const float *coefficients, float *state, int stages)
+{
+    if (channels != 2) {
+        biquadCascadeScalar(data, frames, channels, coefficients, state, stages);
+        return;
+    }
+    if (frames <= 0) {
+        return;
+    }
+
+    const unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040); // flush to zero, denormals are zero
+
+    // Stages go in pairs: the low half of the vector runs the first stage of
+    // the pair on frame n while the high half runs the second one on frame
+    // n - 1, which the low half just produced. This keeps all four lanes
+    // busy even though each channel is a chain of dependent operations.
+    const __m128 lowHalf = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0));
+    int stage = 0;
+    for (; stage + 2 <= stages; stage += 2) {
+        const float *const c = coefficients + stage * 5;
+        float *const s = state + stage * 4;
+        BiquadSse2 k;
+        k.b0 = _mm_setr_ps(c[0], c[0], c[5], c[5]);
+        k.b1 = _mm_setr_ps(c[1], c[1], c[6], c[6]);
+        k.b2 = _mm_setr_ps(c[2], c[2], c[7], c[7]);
+        k.a1 = _mm_setr_ps(c[3], c[3], c[8], c[8]);
+        k.a2 = _mm_setr_ps(c[4], c[4], c[9], c[9]);
+        __m128 s1 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s)),
+                                 reinterpret_cast<const __m64*>(s + 4));
+        __m128 s2 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s + 2)),
+                                 reinterpret_cast<const __m64*>(s + 6));
+
+        // First frame, through the first stage only
+        __m128 s1Before = s1;
+        __m128 s2Before = s2;
+        __m128 y = biquadStepSse2(k, _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(data)), s1, s2);
+        s1 = selectSse2(lowHalf, s1, s1Before);
+        s2 = selectSse2(lowHalf, s2, s2Before);
+
+        float *sample = data + 2;
+        for (int i = 1; i < frames; ++i, sample += 2) {
+            const __m128 x = _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(sample)), y);
+            y = biquadStepSse2(k, x, s1, s2);
+            _mm_storeh_pi(reinterpret_cast<__m64*>(sample - 2), y);
+        }
+
+        // Last frame, through the second stage only
+        s1Before = s1;
+        s2Before = s2;
+        y = biquadStepSse2(k, _mm_movelh_ps(_mm_setzero_ps(), y), s1, s2);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(sample - 2), y);
+        s1 = selectSse2(lowHalf, s1Before, s1);
+        s2 = selectSse2(lowHalf, s2Before, s2);
+
+        _mm_storel_pi(reinterpret_cast<__m64*>(s), s1);
+        _mm_storel_pi(reinterpret_cast<__m64*>(s + 2), s2);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(s + 4), s1);
+        _mm_storeh_pi(reinterpret_cast<__m64*>(s + 6), s2);
+    }
+
+    if (stage < stages) {
+        const float *const c = coefficients + stage * 5;
+        float *const s = state + stage * 4;
+        BiquadSse2 k;
+        k.b0 = _mm_set1_ps(c[0]);
+        k.b1 = _mm_set1_ps(c[1]);
+        k.b2 = _mm_set1_ps(c[2]);
+        k.a1 = _mm_set1_ps(c[3]);
+        k.a2 = _mm_set1_ps(c[4]);
+        __m128 s1 = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s));
+        __m128 s2 = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(s + 2));
+        float *sample = data;
+        for (int i = 0; i < frames; ++i, sample += 2) {
+            const __m128 y = biquadStepSse2(k, _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(sample)), s1, s2);
+            _mm_storel_pi(reinterpret_cast<__m64*>(sample), y);
+        }
+        _mm_storel_pi(reinterpret_cast<__m64*>(s), s1);
+        _mm_storel_pi(reinterpret_cast<__m64*>(s + 2), s2);
+    }
+
+    _mm_setcsr(csr);
+}
+
+__attribute__((target("sse2")))
+static void fftStageSse2(float *re, float *im, const float *wr, const float *wi, int length, int half)
+{
+    if (half < 4) {
+        fftStageScalar(re, im, wr, wi, length, half);
+        return;
+    }
+
+    for (int start = 0; start < length; start += 2 * half) {
+        float *const ar = re + start;
+        float *const ai = im + start;
+        float *const br = ar + half;
+        float *const bi = ai + half;
+        for (int j = 0; j < half; j += 4) {
+            const __m128 vwr = _mm_loadu_ps(wr + j);
+            const __m128 vwi = _mm_loadu_ps(wi + j);
+            const __m128 vbr = _mm_loadu_ps(br + j);
+            const __m128 vbi = _mm_loadu_ps(bi + j);
+            const __m128 var = _mm_loadu_ps(ar + j);
+            const __m128 vai = _mm_loadu_ps(ai + j);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(vbr, vwr), _mm_mul_ps(vbi, vwi));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(vbr, vwi), _mm_mul_ps(vbi, vwr));
+            _mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+        }
+    }
+}
+//END: SSE2 kernels
+
+//BEGIN: AVX2 kernels
+__attribute__((target("avx2")))
+static void int16ToFloatAvx2(const int16_t *in, float *out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+    }
+    int16ToFloatScalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void floatToInt16Avx2(const float *in, int16_t *out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i low = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale));
+        const __m256i high = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale));
+        // packs works per 128 bit lane, put the quadwords back in order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+    floatToInt16Sse2(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void downmixToFloatAvx2(const int16_t *in, float *out, int frames, int channels)
+{
+    if (channels == 1) {
+        int16ToFloatAvx2(in, out, frames);
+        return;
+    }
+    if (channels != 2) {
+        downmixToFloatScalar(in, out, frames, channels);
+        return;
+    }
+
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256 scale = _mm256_set1_ps(1.0f / 65536.0f);
+    int frame = 0;
+    for (; frame + 8 <= frames; frame += 8) {
+        const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + frame * 2));
+        const __m256i sums = _mm256_madd_epi16(samples, ones);
+        _mm256_storeu_ps(out + frame, _mm256_mul_ps(_mm256_cvtepi32_ps(sums), scale));
+    }
+    downmixToFloatSse2(in + frame * 2, out + frame, frames - frame, 2);
+}
+
+__attribute__((target("avx2")))
+static float dotProductAvx2(const float *a, const float *b, int count)
+{
+    __m256 sum = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half) + dotProductScalar(a + i, b + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void mixRampedAvx2(const float *a, float gainA, float stepA,
+                          const float *b, float gainB, float stepB,
+                          float *out, int frames, int channels)
+{
+    if (channels > 2) {
+        mixRampedScalar(a, gainA, stepA, b, gainB, stepB, out, frames, channels);
+        return;
+    }
+
+    const __m256 offset = channels == 1 ? _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+                                        : _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256 vGainA = _mm256_set1_ps(gainA);
+    const __m256 vStepA = _mm256_set1_ps(stepA);
+    const __m256 vGainB = _mm256_set1_ps(gainB);
+    const __m256 vStepB = _mm256_set1_ps(stepB);
+
+    const int count = frames * channels;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 frame = _mm256_add_ps(_mm256_set1_ps(i / channels), offset);
+        const __m256 mixed = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_add_ps(vGainA, _mm256_mul_ps(vStepA, frame))),
+                                           _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_add_ps(vGainB, _mm256_mul_ps(vStepB, frame))));
+        _mm256_storeu_ps(out + i, mixed);
+    }
+
+    const int frame = i / channels;
+    mixRampedScalar(a + i, gainA + stepA * frame, stepA, b + i, gainB + stepB * frame, stepB,
+                    out + i, frames - frame, channels);
+}
+
+__attribute__((target("avx2")))
+static void fftStageAvx2(float *re, float *im, const float *wr, const float *wi, int length, int half)
+{
+    if (half < 8) {
+        fftStageSse2(re, im, wr, wi, length, half);
+        return;
+    }
+
+    for (int start = 0; start < length; start += 2 * half) {
+        float *const ar = re + start;
+        float *const ai = im + start;
+        float *const br = ar + half;
+        float *const bi = ai + half;
+        for (int j = 0; j < half; j += 8) {
+            const __m256 vwr = _mm256_loadu_ps(wr + j);
+            const __m256 vwi = _mm256_loadu_ps(wi + j);
+            const __m256 vbr = _mm256_loadu_ps(br + j);
+            const __m256 vbi = _mm256_loadu_ps(bi + j);
+            const __m256 var = _mm256_loadu_ps(ar + j);
+            const __m256 vai = _mm256_loadu_ps(ai + j);
+            const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(vbr, vwr), _mm256_mul_ps(vbi, vwi));
+            const __m256 ti = _mm256_add_ps(_mm256_mul_ps(vbr, vwi), _mm256_mul_ps(vbi, vwr));
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(var, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(vai, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(var, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(vai, ti));
+        }
+    }
+}
+//END: AVX2 kernels
+#endif
+
+namespace {
+
+    struct Kernels {
+        const char *name;
+        void (*int16ToFloat)(const int16_t*, float*, int);
+        void (*floatToInt16)(const float*, int16_t*, int);
+        void (*downmixToFloat)(const int16_t*, float*, int, int);
+        float (*dotProduct)(const float*, const float*, int);
+        void (*mixRamped)(const float*, float, float, const float*, float, float, float*, int, int);
+        // Filtering is a chain of dependent operations, wider vectors do
+        // not help, so AVX2 uses the SSE2 version
+        void (*biquadCascade)(float*, int, int, const float*, float*, int);
+        void (*fftStage)(float*, float*, const float*, const float*, int, int);
+    };
+
+    Kernels selectKernels()
+    {
+#ifdef AUDIOKERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            const Kernels kernels = { "avx2", &int16ToFloatAvx2, &floatToInt16Avx2, &downmixToFloatAvx2, &dotProductAvx2, &mixRampedAvx2,
+                                       &biquadCascadeSse2, &fftStageAvx2 };
+            return kernels;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            const Kernels kernels = { "sse2", &int16ToFloatSse2, &floatToInt16Sse2, &downmixToFloatSse2, &dotProductSse2, &mixRampedSse2,
+                                       &biquadCascadeSse2, &fftStageSse2 };
+            return kernels;
+        }
+#endif
+        const Kernels kernels = { "scalar", &int16ToFloatScalar, &floatToInt16Scalar, &downmixToFloatScalar, &dotProductScalar, &mixRampedScalar,
+                                   &biquadCascadeScalar, &fftStageScalar };
+        return kernels;
+    }
+
+    const Kernels s_kernels = selectKernels();
+
+}
+
+const char *AudioKernels::instructionSet()
+{
+    return s_kernels.name;
+}
+
+void AudioKernels::int16ToFloat(const int16_t *in, float *out, int count)
+{
+    s_kernels.int16ToFloat(in, out, count);
+}
+
+void AudioKernels::floatToInt16(const float *in, int16_t *out, int count)
+{
+    s_kernels.floatToInt16(in, out, count);
+}
+
+void AudioKernels::downmixToFloat(const int16_t *in, float *out, int frames, int channels)
+{
+    s_kernels.downmixToFloat(in, out, frames, channels);
+}
+
+float AudioKernels::dotProduct(const float *a, const float *b, int count)
+{
+    return s_kernels.dotProduct(a, b, count);
+}
+
+void AudioKernels::mixRamped(const float *a, float gainA, float stepA,
+                             const float *b, float gainB, float stepB,
+                             float *out, int frames, int channels)
+{
+    s_kernels.mixRamped(a, gainA, stepA, b, gainB, stepB, out, frames, channels);
+}
+
+void AudioKernels::biquadCascade(float *data, int frames, int channels,
+                                 const float *coefficients, float *state, int stages)
+{
+    s_kernels.biquadCascade(data, frames, channels, coefficients, state, stages);
+}
+
+void AudioKernels::fftStage(float *re, float *im, const float *wr, const float *wi, int length, int half)
+{
+    s_kernels.fftStage(re, im, wr, wi, length, half);
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIOKERNELS_H
+#define AUDIOKERNELS_H
+
+#include <stdint.h>
+
+/**
+ * Sample processing primitives shared by the audio path. Each one has a
+ * scalar version and, on x86, SSE2 and AVX2 versions picked at runtime
+ * depending on what the CPU supports.
+ */
+namespace AudioKernels {
+
+    /**
+     * Name of the instruction set in use: "avx2", "sse2" or "scalar".
+     */
+    const char *instructionSet();
+
+    /**
+     * Converts to floats in [-1, 1).
+     */
+    void int16ToFloat(const int16_t *in, float *out, int count);
+
+    /**
+     * Converts back from floats in [-1, 1), saturating what is out of range.
+     */
+    void floatToInt16(const float *in, int16_t *out, int count);
+
+    /**
+     * Averages the channels of @p frames interleaved frames into mono
+     * floats in [-1, 1).
+     */
+    void downmixToFloat(const int16_t *in, float *out, int frames, int channels);
+
+    float dotProduct(const float *a, const float *b, int count);
+
+    /**
+     * Mixes two interleaved streams into @p out (which may be @p b), with
+     * gains that change linearly by @p stepA and @p stepB every frame.
+     */
+    void mixRamped(const float *a, float gainA, float stepA,
+                   const float *b, float gainB, float stepB,
+                   float *out, int frames, int channels);
+
+    /**
+     * Runs interleaved @p data, in place, through a cascade of @p stages
+     * biquads in transposed direct form II. @p coefficients holds b0, b1,
+     * b2, a1 and a2 for each stage (a0 normalized to 1), @p state holds the
+     * two delays of each channel for each stage: s1 of every channel and
+     * then s2 of every channel.
+     *
+     * Denormals are flushed to zero while filtering, so that silence does
+     * not slow the filters down.
+     */
+    void biquadCascade(float *data, int frames, int channels,
+                       const float *coefficients, float *state, int stages);
+
+    /**
+     * One radix-2 stage of an in-place complex FFT over @p length values
+     * kept as separate real and imaginary parts. In every block of
+     * 2 * @p half values, the second half is multiplied by the twiddles
+     * @p wr, @p wi (one per position in the half) and butterflied with
+     * the first.
+     */
+    void fftStage(float *re, float *im, const float *wr, const float *wi, int length, int half);
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIONODE_H
+#define AUDIONODE_H
+
+/**
+ * A processing step of the AudioGraph. Nodes work in place on interleaved
+ * float blocks of at most AudioGraph::BlockFrames frames, in the format
+ * last given to setFormat(), and must not allocate while processing.
+ */
+class AudioNode
+{
+public:
+    virtual ~AudioNode() {}
+
+    /**
+     * Short name for statistics.
+     */
+    virtual const char *name() const = 0;
+
+    virtual void setFormat(int sampleRate, int channels) = 0;
+
+    /**
+     * Forgets the audio that went through, as after a seek.
+     */
+    virtual void reset() = 0;
+
+    /**
+     * Whether process() would change anything. Inactive nodes are left out
+     * of the schedule.
+     */
+    virtual bool isActive() const = 0;
+
+    virtual void process(float *data, int frames) = 0;
+};
+
+#endif
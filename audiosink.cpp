@@ -0,0 +1,130 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audiosink.h"
+#include "alsasink.h"
+#include "nullsink.h"
+#include "wavfilesink.h"
+
+#include <KDebug>
+#include <KGlobal>
+#include <KConfigGroup>
+#include <KStandardDirs>
+
+#include <errno.h>
+
+AudioSink::AudioSink()
+    : m_underruns(0)
+    , m_recoveries(0)
+    , m_recoveryMicroseconds(0)
+    , m_longestRecoveryMicroseconds(0)
+    , m_bufferSize(0)
+{
+}
+
+AudioSink::~AudioSink()
+{
+}
+
+void AudioSink::setBuffering(int periodFrames, int periods)
+{
+    Q_UNUSED(periodFrames);
+    Q_UNUSED(periods);
+}
+
+int AudioSink::underruns() const
+{
+    return m_underruns;
+}
+
+int AudioSink::recoveries() const
+{
+    return m_recoveries;
+}
+
+int AudioSink::recoveryMicroseconds() const
+{
+    return m_recoveryMicroseconds;
+}
+
+int AudioSink::longestRecoveryMicroseconds() const
+{
+    return m_longestRecoveryMicroseconds;
+}
+
+int AudioSink::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+bool AudioSink::hasDirectAccess() const
+{
+    return false;
+}
+
+int AudioSink::beginWrite(int16_t **data, int frames)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(frames);
+    return -ENOSYS;
+}
+
+int AudioSink::commitWrite(int frames)
+{
+    Q_UNUSED(frames);
+    return -ENOSYS;
+}
+
+void AudioSink::recordUnderrun()
+{
+    m_underruns.ref();
+}
+
+void AudioSink::recordRecovery(int microseconds)
+{
+    // Recoveries all happen on the thread writing to the sink
+    m_recoveries.ref();
+    m_recoveryMicroseconds.fetchAndAddRelaxed(microseconds);
+    if (microseconds > m_longestRecoveryMicroseconds) {
+        m_longestRecoveryMicroseconds.fetchAndStoreRelaxed(microseconds);
+    }
+}
+
+void AudioSink::recordBufferSize(int frames)
+{
+    m_bufferSize.fetchAndStoreRelaxed(frames);
+}
+
+AudioSink *AudioSink::create()
+{
+    const KConfigGroup config(KGlobal::config(), "Audio");
+    const QString sink = config.readEntry("Sink", "alsa");
+
+    if (sink == "null") {
+        return new NullSink(config.readEntry("NullSinkRealTime", true) ? NullSink::RealTime
+                                                                         : NullSink::AsFastAsPossible);
+    }
+    if (sink == "wav") {
+        const QString fileName = config.readEntry("WavFile", KStandardDirs::locateLocal("appdata", "spokify.wav"));
+        return new WavFileSink(fileName);
+    }
+    if (sink != "alsa") {
+        kWarning() << "Unknown audio sink" << sink << "- falling back to ALSA";
+    }
+    return new AlsaSink(config.readEntry("AlsaDevice", "default"), config.readEntry("AlsaMmap", false));
+}
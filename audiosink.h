@@ -0,0 +1,178 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include <QtCore/QAtomicInt>
+
+#include <stdint.h>
+
+/**
+ * Output backend for the sound feeder. Audio is always interleaved signed
+ * 16 bit native endian. The calls mirror the ALSA ones the feeder used to
+ * make directly: avail()/wait() let the caller write exactly when there is
+ * room, write() never blocks when called with at most avail() frames.
+ *
+ * A sink is used from one thread at a time; callers serialize access.
+ */
+class AudioSink
+{
+public:
+    struct Format {
+        Format(int sampleRate = 44100, int channels = 2)
+            : sampleRate(sampleRate)
+            , channels(channels)
+        {
+        }
+
+        bool operator==(const Format &other) const
+        {
+            return sampleRate == other.sampleRate && channels == other.channels;
+        }
+
+        bool operator!=(const Format &other) const
+        {
+            return !(*this == other);
+        }
+
+        int sampleRate;
+        int channels;
+    };
+
+    virtual ~AudioSink();
+
+    /**
+     * Creates the sink configured in the "Audio" group of the application
+     * config: Sink=alsa (default), null or wav.
+     */
+    static AudioSink *create();
+
+    /**
+     * Asks for @p periods periods of @p periodFrames frames, from the next
+     * open() on. Sinks without a buffer of their own ignore it.
+     */
+    virtual void setBuffering(int periodFrames, int periods);
+
+    /**
+     * Opens the sink, or reconfigures it if already open. Returns false if
+     * the format could not be set up.
+     */
+    virtual bool open(const Format &format) = 0;
+    virtual void close() = 0;
+    virtual Format format() const = 0;
+
+    /**
+     * Number of frames the sink wants to be woken up for.
+     */
+    virtual int periodSize() const = 0;
+
+    /**
+     * Frames that can be written without blocking, or a negative error code.
+     */
+    virtual int avail() = 0;
+
+    /**
+     * Sleeps until at least periodSize() frames can be written, or
+     * @p timeout milliseconds have passed.
+     */
+    virtual bool wait(int timeout) = 0;
+
+    /**
+     * Returns the number of frames written, or a negative error code if the
+     * sink could not recover.
+     */
+    virtual int write(const int16_t *data, int frames) = 0;
+
+    /**
+     * Whether audio can be put straight into the sink's own buffer with
+     * beginWrite() and commitWrite(), instead of being copied by write().
+     */
+    virtual bool hasDirectAccess() const;
+
+    /**
+     * Points @p data to where the next frames go in the sink's buffer. To be
+     * called right after avail(). Returns how many frames fit there, at most
+     * @p frames, or a negative error code.
+     */
+    virtual int beginWrite(int16_t **data, int frames);
+
+    /**
+     * Hands over the first @p frames of what beginWrite() gave. Returns the
+     * number of frames committed, or a negative error code.
+     */
+    virtual int commitWrite(int frames);
+
+    /**
+     * Blocks until everything written has been played.
+     */
+    virtual void drain() = 0;
+
+    /**
+     * Throws away everything written, leaving the sink ready for new audio.
+     * Ends a pause, as what was paused is gone.
+     */
+    virtual void drop() = 0;
+
+    /**
+     * Stops or resumes playing what has been written, keeping it. Returns
+     * false if the sink cannot do that.
+     */
+    virtual bool pause(bool pause) = 0;
+
+    /**
+     * Frames written but not yet audible.
+     */
+    virtual int delay() = 0;
+
+    /**
+     * Times the sink ran out of audio since it was created. Can be called
+     * from any thread.
+     */
+    int underruns() const;
+
+    /**
+     * Times the sink had to be recovered after an error, how long that took
+     * in total and at most. Can be called from any thread.
+     */
+    int recoveries() const;
+    int recoveryMicroseconds() const;
+    int longestRecoveryMicroseconds() const;
+
+    /**
+     * Frames the sink buffers as it was last opened, or 0 if it has no
+     * buffer of its own. Can be called from any thread.
+     */
+    int bufferSize() const;
+
+protected:
+    AudioSink();
+
+    void recordUnderrun();
+    void recordRecovery(int microseconds);
+    void recordBufferSize(int frames);
+
+private:
+    QAtomicInt m_underruns;
+    QAtomicInt m_recoveries;
+    QAtomicInt m_recoveryMicroseconds;
+    QAtomicInt m_longestRecoveryMicroseconds;
+    QAtomicInt m_bufferSize;
+};
+
+#endif
@@ -37,20 +37,15 @@ BlockAnalyzer::BlockAnalyzer( QWidget *parent )
         , m_columns( 0 )         //uint
         , m_rows( 0 )            //uint
         , m_y( 0 )               //uint
-        , m_barPixmap( 1, 1 )    //null qpixmaps cause crashes
-        , m_topBarPixmap( WIDTH, HEIGHT )
         , m_scope( MIN_COLUMNS ) //Scope
         , m_store( 1 << 8, 0 )   //vector<uint>
-        , m_fade_bars( FADE_SIZE ) //vector<QPixmap>
+        , m_bar( 1 << 8, 0 )     //vector<uint>
         , m_fade_pos( 1 << 8, 50 ) //vector<uint>
         , m_fade_intensity( 1 << 8, 32 ) //vector<uint>
+        , m_fadeTime( 0 )
 {
     setMinimumSize( MIN_COLUMNS*(WIDTH+1) -1, MIN_ROWS*(HEIGHT+1) -1 ); //-1 is padding, no drawing takes place there
     setMaximumWidth( MAX_COLUMNS*(WIDTH+1) -1 );
-
-    // mxcl says null pixmaps cause crashes, so let's play it safe
-    for (int i = 0; i < FADE_SIZE; ++i)
-        m_fade_bars[i] = QPixmap( 1, 1 );
 }
 
 BlockAnalyzer::~BlockAnalyzer()
@@ -73,13 +68,9 @@ BlockAnalyzer::resizeEvent( QResizeEvent *e )
    m_y = (height() - (m_rows * (HEIGHT+1)) + 2) / 2;
 
    m_scope.resize( m_columns );
+   m_shown.resize( m_columns );
 
    if( m_rows != oldRows ) {
-      m_barPixmap = QPixmap( WIDTH, m_rows*(HEIGHT+1) );
-
-      for (int i = 0; i < FADE_SIZE; ++i)
-         m_fade_bars[i] = QPixmap( WIDTH, m_rows*(HEIGHT+1) );
-
       m_yscale.resize( m_rows + 1 );
 
       const float PRE = 1, PRO = 1; //PRE and PRO allow us to restrict the range somewhat
@@ -92,10 +83,11 @@ BlockAnalyzer::resizeEvent( QResizeEvent *e )
       determineStep();
       paletteChange( palette() );
    }
-   else if( width() > e->oldSize().width() || height() > e->oldSize().height() )
-      drawBackground();
+
+   m_canvas.resize( width(), height(), m_rows, m_y, m_columns );
 
    analyze( m_scope );
+   animate( 0, true );
 }
 
 void
@@ -104,8 +96,8 @@ BlockAnalyzer::determineStep()
     // falltime is dependent on rowcount due to our digital resolution (ie we have boxes/blocks of pixels)
     // I calculated the value 30 based on some trial and error
 
-    const double fallTime = 30 * m_rows;
-    m_step = double(m_rows * 80) / fallTime; //80 = ~milliseconds between signals with audio data
+    const double fallTime = 30 * m_rows; //milliseconds
+    m_step = double(m_rows) / fallTime;
 }
 
 void
@@ -119,20 +111,20 @@ BlockAnalyzer::transform( QVector<float> &s ) //pure virtual
     m_fht->spectrum( front );
     m_fht->scale( front, 1.0 / 20 );
 
-    //the second half is pretty dull, so only show it if the user has a large analyzer
-    //by setting to m_scope.size() if large we prevent interpolation of large analyzers, this is good!
-    s.resize( m_scope.size() <= MAX_COLUMNS/2 ? MAX_COLUMNS/2 : m_scope.size() );
+    //this runs on the spectrum thread, so it cannot look at m_scope; the
+    //columns are never fewer than MAX_COLUMNS (see resizeEvent()), so
+    //showing every band keeps large analyzers free of interpolation
 }
 
 void
 BlockAnalyzer::analyze( const QVector<float> &s )
 {
+    //called by the render timer, before animate()
     Analyzer::interpolate( s, m_scope );
-    update();
 }
 
-void
-BlockAnalyzer::paintEvent(QPaintEvent*)
+bool
+BlockAnalyzer::animate( int milliseconds, bool )
 {
    // y = 2 3 2 1 0 2
    //     . . . . # .
@@ -147,13 +139,14 @@ BlockAnalyzer::paintEvent(QPaintEvent*)
    // m_yscale looks similar to: { 0.7, 0.5, 0.25, 0.15, 0.1, 0 }
    // if it contains 6 elements there are 5 rows in the analyzer
 
+   // bars fall and fades go out by the time that passed, however often
+   // we are called
+   const float fall = m_step * milliseconds;
+   m_fadeTime += milliseconds;
+   const int fadeSteps = m_fadeTime / FADE_STEP;
+   m_fadeTime %= FADE_STEP;
 
-   QPainter p( this );
-
-   // Paint the background
-   p.drawPixmap(0, 0, m_background);
-//   p.fillRect(rect(), palette().color( QPalette::Active, QPalette::Background ));
-
+   bool changed = false;
    uint y;
 
    for(int x = 0; x < m_scope.size(); ++x)
@@ -162,38 +155,65 @@ BlockAnalyzer::paintEvent(QPaintEvent*)
       for( y = 0; m_scope[x] < m_yscale[y]; ++y )
          ;
 
+      const int oldStore = int(m_store[x]);
+
       // this is opposite to what you'd think, higher than y
       // means the bar is lower than y (physically)
       if( (float)y > m_store[x] )
-         y = uint(m_store[x] += m_step);
+         y = uint(m_store[x] = qMin( m_store[x] + fall, (float)y ));
       else
          m_store[x] = y;
 
+      const int oldIntensity = m_fade_intensity[x];
+
       // if y is lower than m_fade_pos, then the bar has exceeded the height of the fadeout
       // if the fadeout is quite faded now, then display the new one
       if(y <= m_fade_pos[x] /*|| m_fade_intensity[x] < FADE_SIZE / 3*/) {
          m_fade_pos[x] = y;
          m_fade_intensity[x] = FADE_SIZE;
       }
+      else if( m_fade_intensity[x] > 0 ) {
+         m_fade_intensity[x] = qMax( m_fade_intensity[x] - fadeSteps, 0 );
 
-      if( m_fade_intensity[x] > 0 ) {
-         const uint offset = --m_fade_intensity[x];
-         const uint y = m_y + (m_fade_pos[x] * (HEIGHT+1));
-         p.drawPixmap( x*(WIDTH+1), y, m_fade_bars[offset], 0, 0, WIDTH, height() - y );
+         if( m_fade_intensity[x] == 0 )
+            m_fade_pos[x] = m_rows;
       }
 
-      if( m_fade_intensity[x] == 0 )
-         m_fade_pos[x] = m_rows;
+      if( y != m_bar[x] || int(m_store[x]) != oldStore || m_fade_intensity[x] != oldIntensity )
+         changed = true;
 
-      //REMEMBER: y is a number from 0 to m_rows, 0 means all blocks are glowing, m_rows means none are
-      p.drawPixmap( x*(WIDTH+1), y*(HEIGHT+1) + m_y, m_barPixmap, 0, y*(HEIGHT+1), -1, -1 );
+      m_bar[x] = y;
    }
 
-   for( uint x = 0; x < m_store.size(); ++x )
-      p.drawPixmap( x*(WIDTH+1), int(m_store[x])*(HEIGHT+1) + m_y, m_topBarPixmap );
+   return changed;
 }
 
+void
+BlockAnalyzer::paintEvent( QPaintEvent *e )
+{
+   // only draws what animate() left, it is called by the render timer
+   // whenever that changed
+
+   if( m_canvas.image().isNull() )
+      return;
 
+   // columns past the right edge are analyzed but never seen
+   const int columns = qMin( m_scope.size(), (width() + WIDTH) / (WIDTH+1) );
+
+   for( int x = 0; x < columns; ++x )
+   {
+      BlockCanvas::Column &c = m_shown[x];
+      c.bar     = m_bar[x];
+      c.top     = int(m_store[x]);
+      c.fade    = m_fade_intensity[x];
+      c.fadePos = c.fade > 0 ? int(m_fade_pos[x]) : -1;
+   }
+
+   m_canvas.draw( &m_shown[0], columns );
+
+   QPainter p( this );
+   p.drawImage( e->rect(), m_canvas.image(), e->rect() );
+}
 
 
 
@@ -365,58 +385,22 @@ BlockAnalyzer::paletteChange( const QPalette& ) //virtual
    const QColor bg = palette().color(QPalette::Active, QPalette::Background);
    const QColor fg = ensureContrast(bg, palette().color(QPalette::Active, QPalette::Foreground));
 
-   m_topBarPixmap.fill( fg );
-
    const double dr = 15*double(bg.red()   - fg.red())   / (m_rows*16);
    const double dg = 15*double(bg.green() - fg.green()) / (m_rows*16);
    const double db = 15*double(bg.blue()  - fg.blue())  / (m_rows*16);
    const int r = fg.red(), g = fg.green(), b = fg.blue();
 
-   m_barPixmap.fill(bg);
-
-   QPainter p(&m_barPixmap);
+   std::vector<QRgb> bars( m_rows );
    for( int y = 0; (uint)y < m_rows; ++y )
       //graduate the fg color
-      p.fillRect( 0, y*(HEIGHT+1), WIDTH, HEIGHT, QColor( r+int(dr*y), g+int(dg*y), b+int(db*y) ) );
-
-   {
-      const QColor bg = palette().color( QPalette::Active, QPalette::Background ).dark( 112 );
-
-      //make a complimentary fadebar colour
-      //TODO dark is not always correct, dumbo!
-      int h,s,v; palette().color( QPalette::Active, QPalette::Background ).dark( 150 ).getHsv( &h, &s, &v );
-      const QColor fg = QColor::fromHsv( h + 60, s, v );
-
-      const double dr = fg.red() - bg.red();
-      const double dg = fg.green() - bg.green();
-      const double db = fg.blue() - bg.blue();
-      const int r = bg.red(), g = bg.green(), b = bg.blue();
-
-      // Precalculate all fade-bar pixmaps
-      for(int y = 0; y < FADE_SIZE; ++y) {
-         m_fade_bars[y].fill( palette().color( QPalette::Active, QPalette::Background ) );
-         QPainter f( &m_fade_bars[y] );
-         for( int z = 0; (uint)z < m_rows; ++z ) {
-            const double Y = 1.0 - (log10( static_cast<float>(FADE_SIZE) - y ) / log10( static_cast<float>(FADE_SIZE) ));
-            f.fillRect( 0, z*(HEIGHT+1), WIDTH, HEIGHT, QColor( r+int(dr*Y), g+int(dg*Y), b+int(db*Y) ) );
-         }
-      }
-   }
-
-   drawBackground();
-}
-
-void
-BlockAnalyzer::drawBackground()
-{
-    const QColor bg = palette().color( QPalette::Active, QPalette::Background);
-    const QColor bgdark = bg.dark( 112 );
+      bars[y] = QColor( r+int(dr*y), g+int(dg*y), b+int(db*y) ).rgb();
 
-    m_background.fill( bg );
+   //make a complimentary fadebar colour
+   //TODO dark is not always correct, dumbo!
+   int h,s,v; bg.dark( 150 ).getHsv( &h, &s, &v );
 
-    QPainter p( &m_background );
-    for( int x = 0; (uint)x < m_columns; ++x )
-        for( int y = 0; (uint)y < m_rows; ++y )
-            p.fillRect( x*(WIDTH+1), y*(HEIGHT+1) + m_y, WIDTH, HEIGHT, bgdark );
+   m_canvas.setColors( bg.rgb(), bg.dark( 112 ).rgb(), fg.rgb(), bars,
+                       bg.dark( 112 ), QColor::fromHsv( h + 60, s, v ) );
 
+   update();
 }
@@ -18,7 +18,7 @@
 #define BLOCKANALYZER_H
 
 #include "analyzerbase.h"
-#include <QColor>
+#include "blockcanvas.h"
 //Added by qt3to4:
 #include <QResizeEvent>
 #include <QMouseEvent>
@@ -41,39 +41,40 @@ public:
    ~BlockAnalyzer();
 
    // Signed ints because most of what we compare them against are ints
-    static const int HEIGHT      = 2;
-    static const int WIDTH       = 4;
+    static const int HEIGHT      = BlockCanvas::BlockHeight;
+    static const int WIDTH       = BlockCanvas::BlockWidth;
     static const int MIN_ROWS    = 3;   //arbituary
     static const int MIN_COLUMNS = 32;  //arbituary
     static const int MAX_COLUMNS = 256; //must be 2**n
-    static const int FADE_SIZE   = 90;
+    static const int FADE_SIZE   = BlockCanvas::FadeSize;
+    static const int FADE_STEP   = 80;  //milliseconds a fade stays at each step
 
 protected:
     virtual void transform( QVector<float>& );
     virtual void analyze( const QVector<float>& );
+    virtual bool animate( int, bool );
     virtual void paintEvent( QPaintEvent* );
     virtual void resizeEvent( QResizeEvent* );
     virtual void paletteChange( const QPalette& );
 
-    void drawBackground();
     void determineStep();
 
 private:
     uint m_columns, m_rows;      //number of rows and columns of blocks
     uint m_y;                    //y-offset from top of widget
-    QPixmap m_barPixmap;
-    QPixmap m_topBarPixmap;
+    BlockCanvas m_canvas;        //kept between paints, only changed columns are redrawn
+    std::vector<BlockCanvas::Column> m_shown; //what paintEvent() asks the canvas for
     QVector<float> m_scope;               //so we don't create a vector every frame
     std::vector<float> m_store;  //current bar heights
+    std::vector<uint>  m_bar;    //rows of blanks above each bar, see animate()
     std::vector<float> m_yscale;
 
     //FIXME why can't I namespace these? c++ issue?
-    std::vector<QPixmap> m_fade_bars;
     std::vector<uint>    m_fade_pos;
     std::vector<int>     m_fade_intensity;
-    QPixmap              m_background;
+    int                  m_fadeTime; //milliseconds towards the next fade step
 
-    float m_step; //rows to fall per frame
+    float m_step; //rows to fall per millisecond
 };
 
 #endif
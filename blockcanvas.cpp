@@ -0,0 +1,139 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "blockcanvas.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+BlockCanvas::BlockCanvas()
+    : m_rows(0)
+    , m_y(0)
+    , m_redraw(true)
+    , m_background(0)
+    , m_block(0)
+    , m_topBar(0)
+    , m_fades(FadeSize, 0)
+{
+}
+
+void BlockCanvas::resize(int width, int height, int rows, int y, int columns)
+{
+    m_image = QImage(width, height, QImage::Format_RGB32);
+    m_rows = rows;
+    m_y = y;
+    m_drawn.resize(columns);
+    m_redraw = true;
+}
+
+int BlockCanvas::rows() const
+{
+    return m_rows;
+}
+
+void BlockCanvas::setColors(QRgb background, QRgb block, QRgb topBar,
+                            const std::vector<QRgb> &bars,
+                            const QColor &fadeFrom, const QColor &fadeTo)
+{
+    m_background = background;
+    m_block = block;
+    m_topBar = topBar;
+    m_bars = bars;
+    m_fadeFrom = fadeFrom;
+    m_fadeTo = fadeTo;
+    std::fill(m_fades.begin(), m_fades.end(), QRgb(0));
+    m_redraw = true;
+}
+
+int BlockCanvas::draw(const Column *columns, int count)
+{
+    if (m_image.isNull()) {
+        return 0;
+    }
+
+    if (m_redraw) {
+        // The gaps between blocks and the margins never change after this
+        m_image.fill(m_background);
+        for (unsigned int x = 0; x < m_drawn.size(); ++x) {
+            m_drawn[x].bar = -1;
+        }
+        m_redraw = false;
+    }
+
+    count = qMin(count, int(m_drawn.size()));
+    int drawn = 0;
+    for (int x = 0; x < count; ++x) {
+        if (columns[x] != m_drawn[x]) {
+            drawColumn(x, columns[x]);
+            m_drawn[x] = columns[x];
+            ++drawn;
+        }
+    }
+    return drawn;
+}
+
+const QImage &BlockCanvas::image() const
+{
+    return m_image;
+}
+
+void BlockCanvas::drawColumn(int x, const Column &column)
+{
+    // Row m_rows is the margin below the last row, where only the top bar
+    // can be
+    const int left = x * (BlockWidth + 1);
+    const int right = qMin(left + BlockWidth, m_image.width());
+
+    for (int z = 0; z <= m_rows; ++z) {
+        QRgb color;
+        if (z == column.top) {
+            color = m_topBar;
+        } else if (z == m_rows) {
+            color = m_background;
+        } else if (z >= column.bar) {
+            color = m_bars[z];
+        } else if (column.fadePos >= 0 && z >= column.fadePos) {
+            color = fadeColor(column.fade - 1);
+        } else {
+            color = m_block;
+        }
+
+        const int top = qMax(m_y + z * (BlockHeight + 1), 0);
+        const int bottom = qMin(m_y + z * (BlockHeight + 1) + BlockHeight, m_image.height());
+        for (int y = top; y < bottom; ++y) {
+            QRgb *line = reinterpret_cast<QRgb*>(m_image.scanLine(y));
+            for (int i = left; i < right; ++i) {
+                line[i] = color;
+            }
+        }
+    }
+}
+
+QRgb BlockCanvas::fadeColor(int intensity)
+{
+    // Most intensities are never shown
+    QRgb &color = m_fades[intensity];
+    if (!color) {
+        const double y = 1.0 - (log10(double(FadeSize) - intensity) / log10(double(FadeSize)));
+        color = QColor(m_fadeFrom.red() + int((m_fadeTo.red() - m_fadeFrom.red()) * y),
+                       m_fadeFrom.green() + int((m_fadeTo.green() - m_fadeFrom.green()) * y),
+                       m_fadeFrom.blue() + int((m_fadeTo.blue() - m_fadeFrom.blue()) * y)).rgb();
+    }
+    return color;
+}
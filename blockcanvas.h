@@ -0,0 +1,104 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCKCANVAS_H
+#define BLOCKCANVAS_H
+
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+#include <vector>
+
+/**
+ * What BlockAnalyzer shows, kept in an image between paints. Only the
+ * columns that changed since the last draw() are drawn again, with direct
+ * scanline writes; fade colours are worked out on first use.
+ *
+ * Needs no widget, so that it can be drawn offscreen.
+ */
+class BlockCanvas
+{
+public:
+    static const int BlockWidth = 4;
+    static const int BlockHeight = 2;
+    static const int FadeSize = 90;
+
+    /**
+     * What a column shows, in blocks from the top.
+     */
+    struct Column {
+        int bar;      ///< first lit row, rows() if none
+        int top;      ///< row of the top bar, which may be rows()
+        int fadePos;  ///< first row of the fade bar, -1 if none
+        int fade;     ///< intensity of the fade bar, 1 to FadeSize
+
+        bool operator!=(const Column &other) const
+        {
+            return bar != other.bar || top != other.top || fadePos != other.fadePos || fade != other.fade;
+        }
+    };
+
+    BlockCanvas();
+
+    /**
+     * Starts over with a blank image of @p width x @p height, @p rows rows
+     * of blocks from @p y down and room for @p columns columns.
+     */
+    void resize(int width, int height, int rows, int y, int columns);
+
+    int rows() const;
+
+    /**
+     * @p bars holds one colour per row; the fade bars go from @p fadeFrom
+     * at FadeSize to @p fadeTo.
+     */
+    void setColors(QRgb background, QRgb block, QRgb topBar,
+                   const std::vector<QRgb> &bars,
+                   const QColor &fadeFrom, const QColor &fadeTo);
+
+    /**
+     * Draws the first @p count columns of @p columns that are not on the
+     * image yet.
+     * @return the number of columns drawn.
+     */
+    int draw(const Column *columns, int count);
+
+    const QImage &image() const;
+
+private:
+    void drawColumn(int x, const Column &column);
+    QRgb fadeColor(int intensity);
+
+    QImage              m_image;
+    int                 m_rows;
+    int                 m_y;
+    std::vector<Column> m_drawn;
+    // The whole image, after a resize or new colours
+    bool                m_redraw;
+
+    QRgb                m_background;
+    QRgb                m_block;
+    QRgb                m_topBar;
+    std::vector<QRgb>   m_bars;
+    // One per intensity, 0 until first used
+    std::vector<QRgb>   m_fades;
+    QColor              m_fadeFrom;
+    QColor              m_fadeTo;
+};
+
+#endif
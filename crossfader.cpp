@@ -0,0 +1,130 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "crossfader.h"
+#include "audiokernels.h"
+#include "audiograph.h"
+
+#include <QtCore/QtGlobal>
+
+#include <math.h>
+
+Crossfader::Crossfader(int maxSamples)
+    : m_tail(new int16_t[maxSamples])
+    , m_capacity(maxSamples)
+    , m_curve(EqualPower)
+    , m_channels(2)
+    , m_frames(0)
+    , m_position(0)
+{
+}
+
+Crossfader::~Crossfader()
+{
+    delete[] m_tail;
+}
+
+void Crossfader::setCurve(Curve curve)
+{
+    m_curve = curve;
+}
+
+Crossfader::Curve Crossfader::curve() const
+{
+    return m_curve;
+}
+
+int Crossfader::capacity() const
+{
+    return m_capacity;
+}
+
+int16_t *Crossfader::tailBuffer()
+{
+    return m_tail;
+}
+
+void Crossfader::begin(int frames, int channels)
+{
+    m_frames = frames;
+    m_channels = channels;
+    m_position = 0;
+}
+
+bool Crossfader::isFading() const
+{
+    return m_position < m_frames;
+}
+
+const char *Crossfader::name() const
+{
+    return "crossfade";
+}
+
+void Crossfader::setFormat(int sampleRate, int channels)
+{
+    // The tail is held in the format it was written in
+    Q_UNUSED(sampleRate);
+    Q_UNUSED(channels);
+}
+
+bool Crossfader::isActive() const
+{
+    return isFading();
+}
+
+void Crossfader::process(float *data, int frames)
+{
+    float tail[SegmentFrames * AudioGraph::MaxChannels];
+    frames = qMin(frames, m_frames - m_position);
+    int done = 0;
+    while (done < frames) {
+        const int frame = m_position + done;
+        const int length = qMin(frames - done, SegmentFrames - frame % SegmentFrames);
+
+        float outStart, inStart, outEnd, inEnd;
+        gains(frame, &outStart, &inStart);
+        gains(frame + length, &outEnd, &inEnd);
+
+        const int offset = done * m_channels;
+        AudioKernels::int16ToFloat(m_tail + frame * m_channels, tail, length * m_channels);
+        AudioKernels::mixRamped(tail, outStart, (outEnd - outStart) / length,
+                                data + offset, inStart, (inEnd - inStart) / length,
+                                data + offset, length, m_channels);
+        done += length;
+    }
+    m_position += frames;
+}
+
+void Crossfader::reset()
+{
+    m_frames = 0;
+    m_position = 0;
+}
+
+void Crossfader::gains(int frame, float *fadeOut, float *fadeIn) const
+{
+    const float t = float(frame) / m_frames;
+    if (m_curve == Linear) {
+        *fadeOut = 1.0f - t;
+        *fadeIn = t;
+    } else {
+        *fadeOut = cosf(t * float(M_PI_2));
+        *fadeIn = sinf(t * float(M_PI_2));
+    }
+}
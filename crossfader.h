@@ -0,0 +1,95 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CROSSFADER_H
+#define CROSSFADER_H
+
+#include "audionode.h"
+
+#include <stdint.h>
+
+/**
+ * Holds back the tail of a track and mixes it into the beginning of the
+ * next one. The tail is written straight into tailBuffer(), already in the
+ * sink format, and process() then fades it out over the audio that follows
+ * while fading that in.
+ */
+class Crossfader
+    : public AudioNode
+{
+public:
+    enum Curve {
+        Linear = 0,
+        EqualPower
+    };
+
+    Crossfader(int maxSamples);
+    ~Crossfader();
+
+    void setCurve(Curve curve);
+    Curve curve() const;
+
+    /**
+     * Size of tailBuffer(), in samples.
+     */
+    int capacity() const;
+    int16_t *tailBuffer();
+
+    /**
+     * Starts fading out the @p frames that were written to tailBuffer().
+     */
+    void begin(int frames, int channels);
+
+    /**
+     * Whether there is some tail left to mix.
+     */
+    bool isFading() const;
+
+    virtual const char *name() const;
+    virtual void setFormat(int sampleRate, int channels);
+
+    /**
+     * Drops the tail, as after a seek.
+     */
+    virtual void reset();
+
+    /**
+     * Same as isFading().
+     */
+    virtual bool isActive() const;
+
+    /**
+     * Mixes what is left of the tail into @p data, in place.
+     */
+    virtual void process(float *data, int frames);
+
+private:
+    // Equal power gains are followed linearly within segments this long
+    static const int SegmentFrames = 256;
+
+    void gains(int frame, float *fadeOut, float *fadeIn) const;
+
+    int16_t *m_tail;
+    int      m_capacity;
+    Curve    m_curve;
+    int      m_channels;
+    int      m_frames;
+    int      m_position;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "equalizer.h"
+#include "audiokernels.h"
+
+#include <math.h>
+#include <string.h>
+
+const double Equalizer::RampSeconds = 0.03;
+
+Equalizer::Equalizer()
+    : m_sampleRate(0)
+    , m_channels(0)
+    , m_bandCount(0)
+    , m_ramping(false)
+    , m_rampAlpha(1.0)
+    , m_stages(0)
+{
+    for (int i = 0; i < MaxBands; ++i) {
+        m_bandStage[i] = -1;
+    }
+    setFormat(44100, 2);
+}
+
+const char *Equalizer::name() const
+{
+    return "equalizer";
+}
+
+void Equalizer::setFormat(int sampleRate, int channels)
+{
+    if (sampleRate == m_sampleRate && channels == m_channels) {
+        return;
+    }
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_rampAlpha = 1.0 - exp(-RampFrames / (RampSeconds * sampleRate));
+    reset();
+    updateStages();
+}
+
+void Equalizer::setBands(bool enabled, const Band *bands, int count)
+{
+    count = qMin(count, int(MaxBands));
+    for (int i = 0; i < count; ++i) {
+        m_target[i] = bands[i];
+        if (!enabled) {
+            m_target[i].gain = 0;
+        }
+        // New bands start flat and glide in like the rest
+        if (i >= m_bandCount) {
+            m_current[i] = m_target[i];
+            m_current[i].gain = 0;
+        }
+    }
+    m_bandCount = count;
+    m_ramping = true;
+}
+
+int Equalizer::activeBands() const
+{
+    return m_stages;
+}
+
+void Equalizer::reset()
+{
+    memset(m_state, 0, sizeof(m_state));
+}
+
+bool Equalizer::isActive() const
+{
+    return m_stages || m_ramping;
+}
+
+void Equalizer::process(float *data, int frames)
+{
+    if (m_channels > MaxChannels) {
+        return;
+    }
+
+    int done = 0;
+    while (done < frames) {
+        int length = frames - done;
+        if (m_ramping) {
+            ramp();
+            length = qMin(length, int(RampFrames));
+        }
+        AudioKernels::biquadCascade(data + done * m_channels, length, m_channels,
+                                    m_coefficients, m_state, m_stages);
+        done += length;
+    }
+}
+
+void Equalizer::ramp()
+{
+    bool settled = true;
+    for (int i = 0; i < m_bandCount; ++i) {
+        Band &current = m_current[i];
+        const Band &target = m_target[i];
+        current.type = target.type;
+
+        // Gain glides in dB, frequency and Q on a log scale
+        current.gain += (target.gain - current.gain) * m_rampAlpha;
+        if (fabs(target.gain - current.gain) < 0.001) {
+            current.gain = target.gain;
+        } else {
+            settled = false;
+        }
+        const double frequencyRatio = target.frequency / current.frequency;
+        if (fabs(frequencyRatio - 1.0) < 0.0001) {
+            current.frequency = target.frequency;
+        } else {
+            current.frequency *= pow(frequencyRatio, m_rampAlpha);
+            settled = false;
+        }
+        const double qRatio = target.q / current.q;
+        if (fabs(qRatio - 1.0) < 0.0001) {
+            current.q = target.q;
+        } else {
+            current.q *= pow(qRatio, m_rampAlpha);
+            settled = false;
+        }
+    }
+    m_ramping = !settled;
+    updateStages();
+}
+
+void Equalizer::updateStages()
+{
+    // A band at 0dB is an identity filter, so it is left out of the
+    // cascade. Its delays are not zero when it leaves, but the last ramp
+    // step was within a thousandth of a dB, so dropping them is inaudible.
+    // When the band comes back they would be stale, so it starts from
+    // zeroed delays, where an identity filter's settle in this form. The
+    // delays of the bands that stay move along with them.
+    const int stride = 2 * qMin(m_channels, int(MaxChannels));
+    float state[MaxBands * 2 * MaxChannels];
+    int stages = 0;
+    for (int i = 0; i < MaxBands; ++i) {
+        if (i >= m_bandCount || m_current[i].gain == 0) {
+            m_bandStage[i] = -1;
+            continue;
+        }
+        computeCoefficients(m_current[i], m_coefficients + stages * 5);
+        if (m_bandStage[i] >= 0) {
+            memcpy(state + stages * stride, m_state + m_bandStage[i] * stride, stride * sizeof(float));
+        } else {
+            // Back from 0dB, or new
+            memset(state + stages * stride, 0, stride * sizeof(float));
+        }
+        m_bandStage[i] = stages++;
+    }
+    memcpy(m_state, state, stages * stride * sizeof(float));
+    m_stages = stages;
+}
+
+void Equalizer::computeCoefficients(const Band &band, float *coefficients) const
+{
+    // Robert Bristow-Johnson's audio EQ cookbook
+    const double A = pow(10.0, band.gain / 40.0);
+    const double w0 = 2.0 * M_PI * qBound(10.0, band.frequency, 0.45 * m_sampleRate) / m_sampleRate;
+    const double cosw0 = cos(w0);
+    const double alpha = sin(w0) / (2.0 * qMax(band.q, 0.1));
+    const double shelf = 2.0 * sqrt(A) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch (band.type) {
+        case LowShelf:
+            b0 = A * ((A + 1) - (A - 1) * cosw0 + shelf);
+            b1 = 2 * A * ((A - 1) - (A + 1) * cosw0);
+            b2 = A * ((A + 1) - (A - 1) * cosw0 - shelf);
+            a0 = (A + 1) + (A - 1) * cosw0 + shelf;
+            a1 = -2 * ((A - 1) + (A + 1) * cosw0);
+            a2 = (A + 1) + (A - 1) * cosw0 - shelf;
+            break;
+        case HighShelf:
+            b0 = A * ((A + 1) + (A - 1) * cosw0 + shelf);
+            b1 = -2 * A * ((A - 1) + (A + 1) * cosw0);
+            b2 = A * ((A + 1) + (A - 1) * cosw0 - shelf);
+            a0 = (A + 1) - (A - 1) * cosw0 + shelf;
+            a1 = 2 * ((A - 1) - (A + 1) * cosw0);
+            a2 = (A + 1) - (A - 1) * cosw0 - shelf;
+            break;
+        default:
+            b0 = 1 + alpha * A;
+            b1 = -2 * cosw0;
+            b2 = 1 - alpha * A;
+            a0 = 1 + alpha / A;
+            a1 = -2 * cosw0;
+            a2 = 1 - alpha / A;
+            break;
+    }
+
+    coefficients[0] = b0 / a0;
+    coefficients[1] = b1 / a0;
+    coefficients[2] = b2 / a0;
+    coefficients[3] = a1 / a0;
+    coefficients[4] = a2 / a0;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <QtCore/QtGlobal>
+
+#include "audionode.h"
+
+/**
+ * Parametric equalizer: a cascade of peaking and shelving biquads, one per
+ * band, run on float samples.
+ *
+ * When the bands change, gain, frequency and Q glide to their new values
+ * over a few tens of milliseconds with the coefficients recomputed every
+ * RampFrames, so moving a slider does not click. Bands at 0dB are left out
+ * of the cascade, and a disabled equalizer glides to flat and then costs
+ * nothing.
+ */
+class Equalizer
+    : public AudioNode
+{
+public:
+    static const int MaxBands = 16;
+
+    enum BandType {
+        Peaking = 0,
+        LowShelf,
+        HighShelf
+    };
+
+    struct Band {
+        BandType type;
+        double   frequency; ///< Hz
+        double   gain;      ///< dB
+        double   q;
+    };
+
+    Equalizer();
+
+    /**
+     * Sets the bands to glide to. Only the first MaxBands are used.
+     */
+    void setBands(bool enabled, const Band *bands, int count);
+
+    /**
+     * Number of bands that are filtering, 0 if process() has nothing to do.
+     */
+    int activeBands() const;
+
+    virtual const char *name() const;
+    virtual void setFormat(int sampleRate, int channels);
+
+    /**
+     * Clears the filter state, as after a seek.
+     */
+    virtual void reset();
+
+    /**
+     * Whether there is some band to filter with, or to glide to flat.
+     */
+    virtual bool isActive() const;
+
+    /**
+     * Filters @p frames in place.
+     */
+    virtual void process(float *data, int frames);
+
+private:
+    static const int MaxChannels = 8;
+    static const int RampFrames = 32;
+    static const double RampSeconds;
+
+    void ramp();
+    void updateStages();
+    void computeCoefficients(const Band &band, float *coefficients) const;
+
+    int     m_sampleRate;
+    int     m_channels;
+
+    int     m_bandCount;
+    Band    m_target[MaxBands];
+    Band    m_current[MaxBands];
+    bool    m_ramping;
+    double  m_rampAlpha;
+
+    // Bands that are not flat, packed in cascade order
+    int     m_stages;
+    int     m_bandStage[MaxBands]; ///< or -1 if left out
+    float   m_coefficients[MaxBands * 5];
+    float   m_state[MaxBands * 2 * MaxChannels];
+};
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "equalizerdialog.h"
+#include "mainwindow.h"
+
+// KDE includes
+#include <KLocale>
+#include <KGlobal>
+#include <KComboBox>
+#include <KPushButton>
+#include <KConfigGroup>
+#include <KInputDialog>
+#include <KIcon>
+
+// Qt includes
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QSlider>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+
+// Gains of the built in presets, in dB for the default ten bands
+static const struct {
+    const char *name;
+    double gains[10];
+} s_builtinPresets[] = {
+    { I18N_NOOP("Flat"),         {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 } },
+    { I18N_NOOP("Bass Boost"),   {  6.0,  5.0,  3.5,  1.5,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 } },
+    { I18N_NOOP("Treble Boost"), {  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  2.5,  4.0,  5.0,  6.0 } },
+    { I18N_NOOP("Vocal"),        { -2.0, -1.5, -0.5,  1.0,  3.0,  3.5,  3.0,  1.5,  0.0, -1.0 } },
+    { I18N_NOOP("Loudness"),     {  5.0,  4.0,  1.5,  0.0, -1.0,  0.0,  0.0,  1.5,  3.5,  4.5 } }
+};
+
+EqualizerDialog::EqualizerDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_initialEnabled(MainWindow::self()->equalizerEnabled())
+    , m_initialBands(MainWindow::self()->equalizerBands())
+    , m_updating(false)
+{
+    setWindowTitle(i18n("Equalizer"));
+
+    QGridLayout *layout = new QGridLayout;
+    setLayout(layout);
+
+    m_enabled.setText(i18n("Enable equalizer"));
+    m_enabled.setChecked(m_initialEnabled);
+    connect(&m_enabled, SIGNAL(toggled(bool)), this, SLOT(apply()));
+
+    m_preset = new KComboBox(this);
+    m_preset->setEditable(false);
+    connect(m_preset, SIGNAL(activated(QString)), this, SLOT(presetActivated(QString)));
+    KPushButton *savePreset = new KPushButton(KIcon("document-save"), i18n("Save preset..."), this);
+    connect(savePreset, SIGNAL(clicked()), this, SLOT(savePreset()));
+    m_deletePreset = new KPushButton(KIcon("edit-delete"), i18n("Delete preset"), this);
+    connect(m_deletePreset, SIGNAL(clicked()), this, SLOT(deletePreset()));
+
+    const int bandCount = m_initialBands.count();
+    layout->addWidget(&m_enabled, 0, 0, 1, qMax(bandCount, 4));
+    QHBoxLayout *presetLayout = new QHBoxLayout;
+    presetLayout->addWidget(new QLabel(i18n("Preset:")));
+    presetLayout->addWidget(m_preset, 1);
+    presetLayout->addWidget(savePreset);
+    presetLayout->addWidget(m_deletePreset);
+    layout->addLayout(presetLayout, 1, 0, 1, qMax(bandCount, 4));
+
+    for (int i = 0; i < bandCount; ++i) {
+        const Equalizer::Band &band = m_initialBands[i];
+
+        QLabel *gainLabel = new QLabel(this);
+        gainLabel->setAlignment(Qt::AlignCenter);
+
+        // Tenths of dB
+        QSlider *gain = new QSlider(Qt::Vertical, this);
+        gain->setRange(-120, 120);
+        gain->setPageStep(10);
+        gain->setTickPosition(QSlider::TicksBothSides);
+        gain->setTickInterval(30);
+        gain->setValue(qRound(band.gain * 10));
+        connect(gain, SIGNAL(valueChanged(int)), this, SLOT(apply()));
+
+        QSpinBox *frequency = new QSpinBox(this);
+        frequency->setRange(20, 20000);
+        frequency->setSuffix(i18nc("Hertz", " Hz"));
+        frequency->setValue(qRound(band.frequency));
+        connect(frequency, SIGNAL(valueChanged(int)), this, SLOT(apply()));
+
+        QDoubleSpinBox *q = new QDoubleSpinBox(this);
+        q->setRange(0.1, 10.0);
+        q->setSingleStep(0.1);
+        q->setPrefix(i18nc("Quality factor of an equalizer band", "Q "));
+        q->setValue(band.q);
+        connect(q, SIGNAL(valueChanged(double)), this, SLOT(apply()));
+
+        layout->addWidget(gainLabel, 2, i);
+        layout->addWidget(gain, 3, i, Qt::AlignHCenter);
+        layout->addWidget(frequency, 4, i);
+        layout->addWidget(q, 5, i);
+
+        m_gainLabels << gainLabel;
+        m_gains << gain;
+        m_frequencies << frequency;
+        m_q << q;
+        m_types << band.type;
+    }
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, this);
+    connect(buttons, SIGNAL(accepted()), this, SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+    layout->addWidget(buttons, 6, 0, 1, qMax(bandCount, 4));
+
+    loadPresets();
+    updateGainLabels();
+}
+
+EqualizerDialog::~EqualizerDialog()
+{
+}
+
+void EqualizerDialog::accept()
+{
+    MainWindow::self()->setEqualizer(m_enabled.isChecked(), bands());
+    MainWindow::self()->saveEqualizer();
+
+    KConfigGroup config(KGlobal::config(), "Equalizer");
+    config.writeEntry("Preset", m_preset->currentText());
+    config.sync();
+
+    QDialog::accept();
+}
+
+void EqualizerDialog::reject()
+{
+    MainWindow::self()->setEqualizer(m_initialEnabled, m_initialBands);
+
+    QDialog::reject();
+}
+
+void EqualizerDialog::apply()
+{
+    if (m_updating) {
+        return;
+    }
+    updateGainLabels();
+    MainWindow::self()->setEqualizer(m_enabled.isChecked(), bands());
+}
+
+void EqualizerDialog::presetActivated(const QString &name)
+{
+    const QList<double> gains = m_presets.value(name);
+    m_updating = true;
+    for (int i = 0; i < m_gains.count(); ++i) {
+        m_gains[i]->setValue(qRound(gains.value(i) * 10));
+    }
+    m_updating = false;
+    m_deletePreset->setEnabled(!m_builtinPresets.contains(name));
+    apply();
+}
+
+void EqualizerDialog::savePreset()
+{
+    bool ok;
+    const QString name = KInputDialog::getText(i18n("Save Preset"), i18n("Preset name:"),
+                                               m_preset->currentText(), &ok, this).trimmed();
+    if (!ok || name.isEmpty() || m_builtinPresets.contains(name)) {
+        return;
+    }
+
+    QList<double> gains;
+    Q_FOREACH (const QSlider *gain, m_gains) {
+        gains << gain->value() / 10.0;
+    }
+    KConfigGroup config(KGlobal::config(), "Equalizer Presets");
+    config.writeEntry(name, gains);
+    config.sync();
+
+    loadPresets();
+    m_preset->setCurrentIndex(m_preset->findText(name));
+    m_deletePreset->setEnabled(true);
+}
+
+void EqualizerDialog::deletePreset()
+{
+    const QString name = m_preset->currentText();
+    if (m_builtinPresets.contains(name)) {
+        return;
+    }
+
+    KConfigGroup config(KGlobal::config(), "Equalizer Presets");
+    config.deleteEntry(name);
+    config.sync();
+
+    loadPresets();
+}
+
+QList<Equalizer::Band> EqualizerDialog::bands() const
+{
+    QList<Equalizer::Band> bands;
+    for (int i = 0; i < m_gains.count(); ++i) {
+        Equalizer::Band band;
+        band.type = m_types[i];
+        band.frequency = m_frequencies[i]->value();
+        band.gain = m_gains[i]->value() / 10.0;
+        band.q = m_q[i]->value();
+        bands << band;
+    }
+    return bands;
+}
+
+void EqualizerDialog::loadPresets()
+{
+    m_presets.clear();
+    m_builtinPresets.clear();
+    m_preset->clear();
+
+    for (uint i = 0; i < sizeof(s_builtinPresets) / sizeof(s_builtinPresets[0]); ++i) {
+        const QString name = i18n(s_builtinPresets[i].name);
+        QList<double> gains;
+        for (int j = 0; j < 10; ++j) {
+            gains << s_builtinPresets[i].gains[j];
+        }
+        m_presets.insert(name, gains);
+        m_builtinPresets << name;
+        m_preset->addItem(name);
+    }
+
+    const KConfigGroup config(KGlobal::config(), "Equalizer Presets");
+    Q_FOREACH (const QString &name, config.keyList()) {
+        if (m_presets.contains(name)) {
+            continue;
+        }
+        m_presets.insert(name, config.readEntry(name, QList<double>()));
+        m_preset->addItem(name);
+    }
+
+    const QString current = KConfigGroup(KGlobal::config(), "Equalizer").readEntry("Preset", QString());
+    m_preset->setCurrentIndex(qMax(0, m_preset->findText(current)));
+    m_deletePreset->setEnabled(!m_builtinPresets.contains(m_preset->currentText()));
+}
+
+void EqualizerDialog::updateGainLabels()
+{
+    for (int i = 0; i < m_gains.count(); ++i) {
+        m_gainLabels[i]->setText(i18nc("Gain of an equalizer band", "%1 dB",
+                                       KGlobal::locale()->formatNumber(m_gains[i]->value() / 10.0, 1)));
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EQUALIZERDIALOG_H
+#define EQUALIZERDIALOG_H
+
+#include <QDialog> // KDialog has some layouting bugs
+
+#include <QCheckBox>
+#include <QList>
+#include <QMap>
+
+#include "equalizer.h"
+
+class QLabel;
+class QSlider;
+class QSpinBox;
+class QDoubleSpinBox;
+class KComboBox;
+class KPushButton;
+
+/**
+ * Edits the equalizer bands while listening: every change is heard right
+ * away, OK keeps it and Cancel goes back to what was there before. Gains
+ * can be saved as named presets in the "Equalizer Presets" config group.
+ */
+class EqualizerDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit EqualizerDialog(QWidget *parent = 0);
+    virtual ~EqualizerDialog();
+
+public slots:
+    virtual void accept();
+    virtual void reject();
+
+private slots:
+    void apply();
+    void presetActivated(const QString &name);
+    void savePreset();
+    void deletePreset();
+
+private:
+    QList<Equalizer::Band> bands() const;
+    void loadPresets();
+    void updateGainLabels();
+
+    QCheckBox                    m_enabled;
+    KComboBox                   *m_preset;
+    KPushButton                 *m_deletePreset;
+    QList<QSlider*>              m_gains;
+    QList<QLabel*>               m_gainLabels;
+    QList<QSpinBox*>             m_frequencies;
+    QList<QDoubleSpinBox*>       m_q;
+    QList<Equalizer::BandType>   m_types;
+    QMap<QString, QList<double> > m_presets;
+    QStringList                  m_builtinPresets;
+    bool                         m_initialEnabled;
+    QList<Equalizer::Band>       m_initialBands;
+    bool                         m_updating;
+};
+
+#endif//EQUALIZERDIALOG_H
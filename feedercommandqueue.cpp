@@ -0,0 +1,97 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "feedercommandqueue.h"
+#include "playbackclock.h"
+
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+FeederCommandQueue::FeederCommandQueue()
+    : m_eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_writePos(0)
+    , m_readPos(0)
+{
+}
+
+FeederCommandQueue::~FeederCommandQueue()
+{
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+    }
+}
+
+bool FeederCommandQueue::post(Type type, qint64 position)
+{
+    const uint32_t writePos = m_writePos;
+    if (writePos - uint32_t(m_readPos.fetchAndAddAcquire(0)) == Capacity) {
+        return false;
+    }
+
+    Command &command = m_commands[writePos % Capacity];
+    command.type = type;
+    command.position = position;
+    command.posted = PlaybackClock::now();
+    m_writePos.fetchAndStoreRelease(writePos + 1);
+    wakeUp();
+    return true;
+}
+
+bool FeederCommandQueue::isEmpty() const
+{
+    return m_writePos.fetchAndAddAcquire(0) == m_readPos;
+}
+
+bool FeederCommandQueue::take(Command *command)
+{
+    const uint32_t readPos = m_readPos;
+    if (uint32_t(m_writePos.fetchAndAddAcquire(0)) == readPos) {
+        return false;
+    }
+
+    *command = m_commands[readPos % Capacity];
+    m_readPos.fetchAndStoreRelease(readPos + 1);
+    return true;
+}
+
+bool FeederCommandQueue::wait(int timeout)
+{
+    if (isEmpty()) {
+        pollfd pfd;
+        pfd.fd = m_eventFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        while (poll(&pfd, 1, timeout) == -1 && errno == EINTR) {
+        }
+    }
+    uint64_t value;
+    while (::read(m_eventFd, &value, sizeof(value)) == -1 && errno == EINTR) {
+    }
+
+    return !isEmpty();
+}
+
+void FeederCommandQueue::wakeUp()
+{
+    const uint64_t one = 1;
+    while (::write(m_eventFd, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FEEDERCOMMANDQUEUE_H
+#define FEEDERCOMMANDQUEUE_H
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QAtomicInt>
+
+/**
+ * Fixed capacity, single producer/single consumer queue of commands for
+ * the sound feeder. The producer is the GUI thread, the consumer is the
+ * feeder, which takes commands between writes to the sink. Neither side
+ * takes a lock, so posting never waits for a write in flight; the
+ * consumer can sleep (on an eventfd) until something is posted.
+ */
+class FeederCommandQueue
+{
+public:
+    enum Type {
+        Stop = 0,   ///< drop everything for another track, ending any pause
+        Seek,       ///< drop everything, libspotify serves position next
+        Rewind,     ///< go back to position in the ring history
+        Pause,
+        Resume
+    };
+
+    struct Command {
+        Type   type;
+        qint64 position;  ///< microseconds
+        qint64 posted;    ///< when it was posted, on the monotonic clock
+    };
+
+    static const int Capacity = 64;
+
+    FeederCommandQueue();
+    ~FeederCommandQueue();
+
+    //BEGIN: producer side
+    /**
+     * Returns false if the queue is full, which only happens when the
+     * consumer is stuck.
+     */
+    bool post(Type type, qint64 position = 0);
+    //END: producer side
+
+    //BEGIN: consumer side
+    bool isEmpty() const;
+    bool take(Command *command);
+
+    /**
+     * Sleeps until a command is posted, wakeUp() is called or @p timeout
+     * milliseconds have passed. Returns whether there is a command.
+     */
+    bool wait(int timeout = -1);
+    //END: consumer side
+
+    /**
+     * Interrupts wait(). Can be called from any thread.
+     */
+    void wakeUp();
+
+private:
+    Command            m_commands[Capacity];
+    int                m_eventFd;
+    mutable QAtomicInt m_writePos;
+    mutable QAtomicInt m_readPos;
+};
+
+#endif
@@ -20,14 +20,15 @@
 
 
 #include "fht.h"
+#include "realfft.h"
 
 #include <math.h>
 #include <string.h>
 
 FHT::FHT(int n) :
     m_buf(0),
-    m_tab(0),
-    m_log(0)
+    m_log(0),
+    m_fft(0)
 {
     if (n < 3) {
         m_num = 0;
@@ -36,35 +37,17 @@ FHT::FHT(int n) :
     }
     m_exp2 = n;
     m_num = 1 << n;
-    if (n > 3) {
-        m_buf = new float[m_num];
-        m_tab = new float[m_num * 2];
-        makeCasTable();
-    }
+    m_buf = new float[m_num];
+    m_fft = new RealFFT(n);
+    makeLogTable();
 }
 
 
 FHT::~FHT()
 {
     delete[] m_buf;
-    delete[] m_tab;
     delete[] m_log;
-}
-
-
-void FHT::makeCasTable(void)
-{
-    float d, *costab, *sintab;
-    int ul, ndiv2 = m_num / 2;
-
-    for (costab = m_tab, sintab = m_tab + m_num / 2 + 1, ul = 0; ul < m_num; ul++) {
-        d = M_PI * ul / ndiv2;
-        *costab = *sintab = cos(d);
-
-        costab += 2, sintab += 2;
-        if (sintab > m_tab + m_num * 2)
-            sintab = m_tab + 1;
-    }
+    delete m_fft;
 }
 
 
@@ -94,17 +77,21 @@ void FHT::ewma(float *d, float *s, float w)
 }
 
 
+void FHT::makeLogTable()
+{
+    int n = m_num / 2, i, j, *r;
+    m_log = new int[n];
+    float f = n / log10((double)n);
+    for (i = 0, r = m_log; i < n; i++, r++) {
+        j = int(rint(log10(i + 1.0) * f));
+        *r = j >= n ? n - 1 : j;
+    }
+}
+
+
 void FHT::logSpectrum(float *out, float *p)
 {
     int n = m_num / 2, i, j, k, *r;
-    if (!m_log) {
-        m_log = new int[n];
-        float f = n / log10((double)n);
-        for (i = 0, r = m_log; i < n; i++, r++) {
-            j = int(rint(log10(i + 1.0) * f));
-            *r = j >= n ? n - 1 : j;
-        }
-    }
     semiLogSpectrum(p);
     *out++ = *p = *p / 100;
     for (k = i = 1, r = m_log; i < n; ++i) {
@@ -150,23 +137,35 @@ void FHT::power(float *p)
 
 void FHT::power2(float *p)
 {
-    int i;
-    float *q;
-    _transform(p, m_num, 0);
+    // Twice the squared magnitude of each Fourier bin, which is what the
+    // sum of the squares of Hartley bins k and n - k used to give
+    m_fft->transform(p);
 
-    *p = (*p * *p), *p += *p, p++;
+    *p = 2 * *p * *p;
 
-    for (i = 1, q = p + m_num - 2; i < (m_num / 2); i++, --q)
-        *p = (*p * *p) + (*q * *q), p++;
+    for (int i = 1; i < (m_num / 2); i++)
+        p[i] = 2 * (p[2 * i] * p[2 * i] + p[2 * i + 1] * p[2 * i + 1]);
 }
 
 
 void FHT::transform(float *p)
 {
-    if (m_num == 8)
+    if (m_num == 8) {
         transform8(p);
-    else
-        _transform(p, m_num, 0);
+        return;
+    }
+
+    // Hartley bin k is Re - Im of Fourier bin k, and bin n - k is Re + Im
+    m_fft->transform(p);
+
+    const int ndiv2 = m_num / 2;
+    m_buf[0] = p[0];
+    m_buf[ndiv2] = p[1];
+    for (int i = 1; i < ndiv2; i++) {
+        m_buf[i] = p[2 * i] - p[2 * i + 1];
+        m_buf[m_num - i] = p[2 * i] + p[2 * i + 1];
+    }
+    memcpy(p, m_buf, sizeof(float) * m_num);
 }
 
 
@@ -198,46 +197,3 @@ void FHT::transform8(float *p)
     *--p = aceg + bdfh;
 }
 
-
-void FHT::_transform(float *p, int n, int k)
-{
-    if (n == 8) {
-        transform8(p + k);
-        return;
-    }
-
-    int i, j, ndiv2 = n / 2;
-    float a, *t1, *t2, *t3, *t4, *ptab, *pp;
-
-    for (i = 0, t1 = m_buf, t2 = m_buf + ndiv2, pp = &p[k]; i < ndiv2; i++)
-        *t1++ = *pp++, *t2++ = *pp++;
-
-    memcpy(p + k, m_buf, sizeof(float) * n);
-
-    _transform(p, ndiv2, k);
-    _transform(p, ndiv2, k + ndiv2);
-
-    j = m_num / ndiv2 - 1;
-    t1 = m_buf;
-    t2 = t1 + ndiv2;
-    t3 = p + k + ndiv2;
-    ptab = m_tab;
-    pp = p + k;
-
-    a = *ptab++ * *t3++;
-    a += *ptab * *pp;
-    ptab += j;
-
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
-
-    for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-        a = *ptab++ * *t3++;
-        a += *ptab * *--t4;
-
-        *t1++ = *pp + a;
-        *t2++ = *pp++ - a;
-    }
-    memcpy(p + k, m_buf, sizeof(float) * n);
-}
-
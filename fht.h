@@ -21,39 +21,32 @@
 #ifndef FHT_H
 #define FHT_H
 
+class RealFFT;
+
 /**
- * Implementation of the Hartley Transform after Bracewell's discrete
- * algorithm. The algorithm is subject to US patent No. 4,646,256 (1987)
- * but was put into public domain by the Board of Trustees of Stanford
- * University in 1994 and is now freely available[1].
- *
- * [1] Computer in Physics, Vol. 9, No. 4, Jul/Aug 1995 pp 373-379
+ * Audio spectra for the analyzers. Originally a recursive Hartley
+ * transform after Bracewell's algorithm; the transforms are now done by
+ * RealFFT, an iterative real FFT, and the Hartley transform is derived
+ * from its result where it is still asked for.
  */
 class FHT
 {
 	int	m_exp2;
 	int	m_num;
 	float	*m_buf;
-	float	*m_tab;
 	int	*m_log;
+	RealFFT	*m_fft;
 
 	/**
-	 * Create a table of "cas" (cosine and sine) values.
-	 * Has only to be done in the constructor and saves from
-	 * calculating the same values over and over while transforming.
-	 */
-	void	makeCasTable();
-
-	/**
-	 * Recursive in-place Hartley transform. For internal use only!
+	 * Create the logarithmic index map of logSpectrum(). Done in the
+	 * constructor, so that no transform allocates.
 	 */
-	void	_transform(float *, int, int);
+	void	makeLogTable();
 
    public:
 	/**
 	* Prepare transform for data sets with @f$2^n@f$ numbers, whereby @f$n@f$
-	* should be at least 3. Values of more than 3 need a trigonometry table.
-	* @see makeCasTable()
+	* should be at least 3.
 	*/
 	FHT(int);
 
@@ -75,7 +68,6 @@ class FHT
 	/**
 	 * Logarithmic audio spectrum. Maps semi-logarithmic spectrum
 	 * to logarithmic frequency scale, interpolates missing values.
-	 * A logarithmic index map is calculated at the first run only.
 	 * @param p is the input array.
 	 * @param out is the spectrum.
 	 */
@@ -113,6 +105,9 @@ class FHT
 	 */
 	void	transform8(float *);
 
+	/**
+	 * Discrete Hartley transform.
+	 */
 	void	transform(float *);
 };
 
@@ -0,0 +1,227 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "formatconverter.h"
+#include "audiokernels.h"
+
+#include <QtCore/QtGlobal>
+
+#include <math.h>
+#include <string.h>
+
+static int greatestCommonDivisor(int a, int b)
+{
+    while (b) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+FormatConverter::FormatConverter(int maxInputFrames)
+    : m_maxInputFrames(maxInputFrames)
+    , m_upFactor(1)
+    , m_downFactor(1)
+    , m_phase(0)
+    , m_coefficients(new float[MaxPhases * Taps])
+    , m_historyFrames(0)
+    , m_inputScratch(new float[maxInputFrames * MaxChannels])
+    , m_outputScratch(0)
+{
+    for (int i = 0; i < MaxChannels; ++i) {
+        m_history[i] = new float[Taps + maxInputFrames];
+    }
+    setFormats(AudioSink::Format(), AudioSink::Format());
+}
+
+FormatConverter::~FormatConverter()
+{
+    for (int i = 0; i < MaxChannels; ++i) {
+        delete[] m_history[i];
+    }
+    delete[] m_coefficients;
+    delete[] m_inputScratch;
+    delete[] m_outputScratch;
+}
+
+void FormatConverter::setFormats(const AudioSink::Format &input, const AudioSink::Format &output)
+{
+    m_input = input;
+    m_output = output;
+    m_input.channels = qBound(1, m_input.channels, int(MaxChannels));
+    m_output.channels = qBound(1, m_output.channels, int(MaxChannels));
+
+    const int divisor = greatestCommonDivisor(m_output.sampleRate, m_input.sampleRate);
+    m_upFactor = m_output.sampleRate / divisor;
+    m_downFactor = m_input.sampleRate / divisor;
+    if (m_upFactor > MaxPhases) {
+        // Odd pair of rates; get as close as the phase table allows
+        m_downFactor = qMax(1, int(qint64(m_downFactor) * MaxPhases / m_upFactor));
+        m_upFactor = MaxPhases;
+    }
+
+    delete[] m_outputScratch;
+    m_outputScratch = new float[(qint64(m_maxInputFrames) * m_upFactor / m_downFactor + 2) * m_output.channels];
+
+    computeCoefficients();
+    reset();
+}
+
+AudioSink::Format FormatConverter::inputFormat() const
+{
+    return m_input;
+}
+
+AudioSink::Format FormatConverter::outputFormat() const
+{
+    return m_output;
+}
+
+bool FormatConverter::isPassthrough() const
+{
+    return m_input == m_output;
+}
+
+void FormatConverter::reset()
+{
+    m_phase = 0;
+    // Start with silence as history, so the first output frame lines up
+    // with the first input frame
+    m_historyFrames = m_upFactor == m_downFactor ? 0 : Taps / 2 - 1;
+    for (int i = 0; i < MaxChannels; ++i) {
+        memset(m_history[i], 0, (Taps + m_maxInputFrames) * sizeof(float));
+    }
+}
+
+int FormatConverter::maxInputFrames(int outputFrames) const
+{
+    if (m_upFactor == m_downFactor) {
+        return qMin(outputFrames, m_maxInputFrames);
+    }
+    return qBound(0, int(qint64(outputFrames - 2) * m_downFactor / m_upFactor), m_maxInputFrames);
+}
+
+int FormatConverter::convert(const int16_t *input, int inputFrames, int16_t *output)
+{
+    if (isPassthrough()) {
+        memcpy(output, input, inputFrames * m_input.channels * sizeof(int16_t));
+        return inputFrames;
+    }
+
+    inputFrames = qMin(inputFrames, m_maxInputFrames);
+    AudioKernels::int16ToFloat(input, m_inputScratch, inputFrames * m_input.channels);
+    mixChannels(m_inputScratch, inputFrames);
+
+    const int channels = m_output.channels;
+    int outputFrames = 0;
+
+    if (m_upFactor == m_downFactor) {
+        for (int i = 0; i < m_historyFrames; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                m_outputScratch[i * channels + c] = m_history[c][i];
+            }
+        }
+        outputFrames = m_historyFrames;
+        m_historyFrames = 0;
+    } else {
+        int start = 0;
+        while (start + Taps <= m_historyFrames) {
+            const float *const coefficients = m_coefficients + m_phase * Taps;
+            for (int c = 0; c < channels; ++c) {
+                m_outputScratch[outputFrames * channels + c] = AudioKernels::dotProduct(coefficients, m_history[c] + start, Taps);
+            }
+            ++outputFrames;
+            m_phase += m_downFactor;
+            start += m_phase / m_upFactor;
+            m_phase %= m_upFactor;
+        }
+        // Keep what the next output frames still need
+        const int remaining = m_historyFrames - start;
+        for (int c = 0; c < channels; ++c) {
+            memmove(m_history[c], m_history[c] + start, remaining * sizeof(float));
+        }
+        m_historyFrames = remaining;
+    }
+
+    AudioKernels::floatToInt16(m_outputScratch, output, outputFrames * channels);
+    return outputFrames;
+}
+
+void FormatConverter::computeCoefficients()
+{
+    if (m_upFactor == m_downFactor) {
+        return;
+    }
+
+    // Cut off a bit below the lower of both Nyquist frequencies, in cycles
+    // per input sample
+    const double cutoff = 0.5 * qMin(1.0, double(m_upFactor) / m_downFactor) * 0.92;
+
+    for (int phase = 0; phase < m_upFactor; ++phase) {
+        float *const coefficients = m_coefficients + phase * Taps;
+        double sum = 0;
+        for (int tap = 0; tap < Taps; ++tap) {
+            // Distance from the output instant to this input sample
+            const double t = tap - (Taps / 2 - 1) - double(phase) / m_upFactor;
+            const double x = 2 * cutoff * t;
+            const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            const double w = (t + Taps / 2) / Taps;
+            const double window = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+            coefficients[tap] = sinc * window;
+            sum += coefficients[tap];
+        }
+        // Unity gain at DC for every phase
+        for (int tap = 0; tap < Taps; ++tap) {
+            coefficients[tap] /= sum;
+        }
+    }
+}
+
+void FormatConverter::mixChannels(const float *input, int frames)
+{
+    const int inChannels = m_input.channels;
+    const int outChannels = m_output.channels;
+
+    for (int c = 0; c < outChannels; ++c) {
+        float *const history = m_history[c] + m_historyFrames;
+        if (inChannels <= outChannels) {
+            // Same layout or upmix: output channel c takes input c, mono is
+            // spread over every channel
+            const int source = c % inChannels;
+            for (int i = 0; i < frames; ++i) {
+                history[i] = input[i * inChannels + source];
+            }
+        } else {
+            // Downmix: average the input channels folding onto this one
+            int count = 0;
+            for (int source = c; source < inChannels; source += outChannels) {
+                ++count;
+            }
+            const float gain = 1.0f / count;
+            for (int i = 0; i < frames; ++i) {
+                float sum = 0;
+                for (int source = c; source < inChannels; source += outChannels) {
+                    sum += input[i * inChannels + source];
+                }
+                history[i] = sum * gain;
+            }
+        }
+    }
+    m_historyFrames += frames;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FORMATCONVERTER_H
+#define FORMATCONVERTER_H
+
+#include "audiosink.h"
+
+/**
+ * Converts interleaved 16 bit audio between formats the sink could not be
+ * configured for: channels are up or down mixed, and the sample rate is
+ * changed with a windowed sinc polyphase filter. State is kept between
+ * calls so a stream can be converted block by block, and nothing is
+ * allocated after setFormats().
+ */
+class FormatConverter
+{
+public:
+    static const int MaxChannels = 8;
+
+    FormatConverter(int maxInputFrames);
+    ~FormatConverter();
+
+    void setFormats(const AudioSink::Format &input, const AudioSink::Format &output);
+    AudioSink::Format inputFormat() const;
+    AudioSink::Format outputFormat() const;
+
+    /**
+     * Whether input and output formats are the same, and convert() would
+     * only copy.
+     */
+    bool isPassthrough() const;
+
+    /**
+     * Forgets the stream history, as after a seek.
+     */
+    void reset();
+
+    /**
+     * The most input frames that can be converted at once without producing
+     * more than @p outputFrames.
+     */
+    int maxInputFrames(int outputFrames) const;
+
+    /**
+     * Converts @p inputFrames frames, which must not exceed
+     * maxInputFrames() for the room in @p output.
+     * @return the number of frames written to @p output.
+     */
+    int convert(const int16_t *input, int inputFrames, int16_t *output);
+
+private:
+    static const int Taps = 32;
+    static const int MaxPhases = 1024;
+
+    void computeCoefficients();
+    void mixChannels(const float *input, int frames);
+
+    const int         m_maxInputFrames;
+    AudioSink::Format m_input;
+    AudioSink::Format m_output;
+
+    // Output rate / input rate == m_upFactor / m_downFactor
+    int               m_upFactor;
+    int               m_downFactor;
+    int               m_phase;
+    float            *m_coefficients;
+
+    // Per output channel input history, mixed but not yet resampled
+    float            *m_history[MaxChannels];
+    int               m_historyFrames;
+
+    float            *m_inputScratch;
+    float            *m_outputScratch;
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latencytuner.h"
+#include "playbackclock.h"
+
+// Period sizes the adaptive profile moves between, the fixed profiles are
+// the first, middle and last of them. Times are at 44.1kHz.
+static const int s_periodFrames[] = {
+    256,  //  23ms of buffer
+    512,
+    1024, //  93ms
+    2048,
+    4096  // 372ms
+};
+static const int s_steps = sizeof(s_periodFrames) / sizeof(s_periodFrames[0]);
+
+static int profileStep(LatencyTuner::Profile profile)
+{
+    switch (profile) {
+        case LatencyTuner::LowLatency:
+            return 0;
+        case LatencyTuner::PowerSave:
+            return s_steps - 1;
+        default:
+            return s_steps / 2;
+    }
+}
+
+LatencyTuner::LatencyTuner()
+    : m_profile(Balanced)
+    , m_step(profileStep(Balanced))
+    , m_lastFill(0)
+    , m_closeCalls(0)
+    , m_closeCallsSeen(0)
+    , m_underrunsSeen(0)
+    , m_quietSince(PlaybackClock::now())
+    , m_quietNeeded(MinQuietMicroseconds)
+{
+}
+
+int LatencyTuner::initialPeriodFrames(Profile profile)
+{
+    return s_periodFrames[profileStep(profile)];
+}
+
+void LatencyTuner::setProfile(Profile profile)
+{
+    m_profile = profile;
+    m_step = profileStep(profile);
+    m_quietSince = PlaybackClock::now();
+    m_quietNeeded = MinQuietMicroseconds;
+}
+
+LatencyTuner::Profile LatencyTuner::profile() const
+{
+    return m_profile;
+}
+
+int LatencyTuner::periodFrames() const
+{
+    return s_periodFrames[m_step];
+}
+
+void LatencyTuner::recordFill(int before, int after)
+{
+    const int period = s_periodFrames[m_step];
+    if (m_lastFill >= 2 * period && before < period) {
+        ++m_closeCalls;
+    }
+    m_lastFill = after;
+}
+
+void LatencyTuner::interrupt()
+{
+    m_lastFill = 0;
+}
+
+bool LatencyTuner::trackBoundary(int underruns)
+{
+    const bool underrun = underruns != m_underrunsSeen;
+    const bool closeCall = m_closeCalls != m_closeCallsSeen;
+    m_underrunsSeen = underruns;
+    m_closeCallsSeen = m_closeCalls;
+    if (m_profile != Adaptive) {
+        return false;
+    }
+
+    const qint64 now = PlaybackClock::now();
+    if (underrun || closeCall) {
+        if (m_step == s_steps - 1) {
+            m_quietSince = now;
+            return false;
+        }
+        m_quietNeeded = qMin(m_quietNeeded * 2, qint64(MaxQuietMicroseconds));
+        resize(m_step + 1);
+        return true;
+    }
+    if (m_step > 0 && now - m_quietSince >= m_quietNeeded) {
+        resize(m_step - 1);
+        return true;
+    }
+    return false;
+}
+
+int LatencyTuner::closeCalls() const
+{
+    return m_closeCalls;
+}
+
+void LatencyTuner::resize(int step)
+{
+    m_step = step;
+    m_lastFill = 0;
+    m_quietSince = PlaybackClock::now();
+}
@@ -0,0 +1,100 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCYTUNER_H
+#define LATENCYTUNER_H
+
+#include <QtCore/QtGlobal>
+
+/**
+ * Picks the sink's period size for a latency profile. In the Adaptive
+ * profile it starts out balanced and then follows what it sees: a buffer
+ * that underruns, or that is found nearly empty although it was filled
+ * well before, grows one step; one that has been fine for a while shrinks
+ * one step. The longer it has to stay fine the more it grew before, so
+ * that it does not go back and forth.
+ *
+ * Changes are only asked for at track boundaries, where reopening the
+ * sink cannot be heard mid track. Only used from the sound feeder thread.
+ */
+class LatencyTuner
+{
+public:
+    enum Profile {
+        LowLatency = 0,
+        Balanced,
+        PowerSave,
+        Adaptive
+    };
+
+    static const int Periods = 4;
+
+    LatencyTuner();
+
+    static int initialPeriodFrames(Profile profile);
+
+    void setProfile(Profile profile);
+    Profile profile() const;
+
+    /**
+     * Period size the sink should have now.
+     */
+    int periodFrames() const;
+
+    /**
+     * The sink was found holding @p before frames and then written up to
+     * @p after.
+     */
+    void recordFill(int before, int after);
+
+    /**
+     * Forgets the last fill, when the sink was emptied or the feeder ran
+     * out of audio, so that the next one is not taken for a close call.
+     */
+    void interrupt();
+
+    /**
+     * Looks at how the sink did, given the @p underruns it reports in
+     * total. Returns true if periodFrames() changed.
+     */
+    bool trackBoundary(int underruns);
+
+    /**
+     * Writes that found the sink holding less than a period although the
+     * write before left at least two in it.
+     */
+    int closeCalls() const;
+
+private:
+    // Quiet time needed before shrinking, doubled on every growth
+    static const qint64 MinQuietMicroseconds = 120000000LL;
+    static const qint64 MaxQuietMicroseconds = 1800000000LL;
+
+    void resize(int step);
+
+    Profile m_profile;
+    int     m_step;
+    int     m_lastFill;
+    int     m_closeCalls;
+    int     m_closeCallsSeen;
+    int     m_underrunsSeen;
+    qint64  m_quietSince;
+    qint64  m_quietNeeded;
+};
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loudnessnormalizer.h"
+#include "audiokernels.h"
+
+#include <math.h>
+#include <string.h>
+
+const double LoudnessNormalizer::MaxGainDb = 6.0;
+const double LoudnessNormalizer::MinGainDb = -24.0;
+const double LoudnessNormalizer::SlewDbPerSecond = 3.0;
+
+// Before this much audio has been measured the gain is left alone
+static const int MinMeasuredSeconds = 3;
+
+static inline double blockLoudness(double energy)
+{
+    return -0.691 + 10.0 * log10(energy);
+}
+
+LoudnessNormalizer::LoudnessNormalizer(int maxSamples)
+    : m_enabled(true)
+    , m_target(-14.0)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_scratch(new float[maxSamples])
+    , m_knownLoudness(UnknownLoudness)
+    , m_gainDb(0)
+{
+    setFormat(44100, 2);
+}
+
+LoudnessNormalizer::~LoudnessNormalizer()
+{
+    delete[] m_scratch;
+}
+
+void LoudnessNormalizer::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool LoudnessNormalizer::isEnabled() const
+{
+    return m_enabled;
+}
+
+void LoudnessNormalizer::setTargetLoudness(double lufs)
+{
+    m_target = lufs;
+}
+
+const char *LoudnessNormalizer::name() const
+{
+    return "normalization";
+}
+
+bool LoudnessNormalizer::isActive() const
+{
+    return m_enabled;
+}
+
+void LoudnessNormalizer::reset()
+{
+    memset(m_state, 0, sizeof(m_state));
+}
+
+void LoudnessNormalizer::setFormat(int sampleRate, int channels)
+{
+    if (sampleRate == m_sampleRate && channels == m_channels) {
+        return;
+    }
+    m_sampleRate = sampleRate;
+    m_channels = qMin(channels, int(MaxChannels));
+
+    // ITU-R BS.1770 K-weighting, recomputed for the sample rate
+    double K = tan(M_PI * 1681.974450955533 / sampleRate);
+    double Q = 0.7071752369554196;
+    const double Vh = pow(10.0, 3.999843853973347 / 20.0);
+    const double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    m_shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    m_shelf.b1 = 2.0 * (K * K - Vh) / a0;
+    m_shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    m_shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+    m_shelf.a2 = (1.0 - K / Q + K * K) / a0;
+
+    K = tan(M_PI * 38.13547087602444 / sampleRate);
+    Q = 0.5003270373238773;
+    a0 = 1.0 + K / Q + K * K;
+    m_highPass.b0 = 1.0;
+    m_highPass.b1 = -2.0;
+    m_highPass.b2 = 1.0;
+    m_highPass.a1 = 2.0 * (K * K - 1.0) / a0;
+    m_highPass.a2 = (1.0 - K / Q + K * K) / a0;
+
+    m_subBlockFrames = sampleRate / 10;
+    startTrack(m_knownLoudness);
+}
+
+void LoudnessNormalizer::startTrack(double lufs)
+{
+    memset(m_state, 0, sizeof(m_state));
+    m_subBlockFill = 0;
+    m_subBlockEnergy = 0;
+    m_subBlockCount = 0;
+    memset(m_histogramEnergy, 0, sizeof(m_histogramEnergy));
+    memset(m_histogramCount, 0, sizeof(m_histogramCount));
+    m_measuredFrames = 0;
+
+    m_knownLoudness = lufs;
+    if (m_knownLoudness != UnknownLoudness) {
+        m_gainDb = targetGainDb();
+    }
+}
+
+double LoudnessNormalizer::measuredLoudness() const
+{
+    if (m_measuredFrames < qint64(MinMeasuredSeconds) * m_sampleRate) {
+        return UnknownLoudness;
+    }
+
+    double energy = 0;
+    int count = 0;
+    for (int i = 0; i < HistogramBins; ++i) {
+        energy += m_histogramEnergy[i];
+        count += m_histogramCount[i];
+    }
+    if (!count) {
+        return UnknownLoudness;
+    }
+
+    // Relative gate, 10 LU under the absolutely gated loudness
+    const double relativeGate = blockLoudness(energy / count) - 10.0;
+    const int firstBin = qBound(0, int(ceil((relativeGate + 70.0) * 10.0)), HistogramBins);
+    energy = 0;
+    count = 0;
+    for (int i = firstBin; i < HistogramBins; ++i) {
+        energy += m_histogramEnergy[i];
+        count += m_histogramCount[i];
+    }
+    return count ? blockLoudness(energy / count) : UnknownLoudness;
+}
+
+void LoudnessNormalizer::process(float *data, int frames)
+{
+    if (!m_enabled || frames <= 0) {
+        return;
+    }
+
+    measure(data, frames);
+
+    const double maxStep = SlewDbPerSecond * frames / m_sampleRate;
+    const double gainDb = m_gainDb + qBound(-maxStep, targetGainDb() - m_gainDb, maxStep);
+    const float startGain = pow(10.0, m_gainDb / 20.0);
+    const float endGain = pow(10.0, gainDb / 20.0);
+    m_gainDb = gainDb;
+
+    if (startGain == 1.0f && endGain == 1.0f) {
+        return;
+    }
+    AudioKernels::mixRamped(data, startGain, (endGain - startGain) / frames, data, 0, 0,
+                            data, frames, m_channels);
+}
+
+void LoudnessNormalizer::measure(const float *data, int frames)
+{
+    for (int channel = 0; channel < m_channels; ++channel) {
+        double *const s = m_state[channel];
+        const float *input = data + channel;
+        float *sample = m_scratch + channel;
+        for (int i = 0; i < frames; ++i, input += m_channels, sample += m_channels) {
+            // Transposed direct form II, both stages
+            const double x = *input;
+            const double y = m_shelf.b0 * x + s[0];
+            s[0] = m_shelf.b1 * x - m_shelf.a1 * y + s[1];
+            s[1] = m_shelf.b2 * x - m_shelf.a2 * y;
+            const double z = m_highPass.b0 * y + s[2];
+            s[2] = m_highPass.b1 * y - m_highPass.a1 * z + s[3];
+            s[3] = m_highPass.b2 * y - m_highPass.a2 * z;
+            *sample = z;
+        }
+    }
+
+    const float *filtered = m_scratch;
+    while (frames > 0) {
+        const int length = qMin(frames, m_subBlockFrames - m_subBlockFill);
+        const int count = length * m_channels;
+        m_subBlockEnergy += AudioKernels::dotProduct(filtered, filtered, count);
+        m_subBlockFill += length;
+        m_measuredFrames += length;
+        filtered += count;
+        frames -= length;
+        if (m_subBlockFill == m_subBlockFrames) {
+            addBlock();
+        }
+    }
+}
+
+void LoudnessNormalizer::addBlock()
+{
+    m_subBlocks[m_subBlockCount % 4] = m_subBlockEnergy / m_subBlockFrames;
+    ++m_subBlockCount;
+    m_subBlockFill = 0;
+    m_subBlockEnergy = 0;
+    if (m_subBlockCount < 4) {
+        return;
+    }
+
+    const double energy = (m_subBlocks[0] + m_subBlocks[1] + m_subBlocks[2] + m_subBlocks[3]) / 4.0;
+    const double loudness = blockLoudness(energy);
+    if (loudness <= -70.0) {
+        return;
+    }
+    const int bin = qMin(int((loudness + 70.0) * 10.0), HistogramBins - 1);
+    m_histogramEnergy[bin] += energy;
+    ++m_histogramCount[bin];
+}
+
+double LoudnessNormalizer::targetGainDb() const
+{
+    double loudness = m_knownLoudness;
+    if (loudness == UnknownLoudness) {
+        loudness = measuredLoudness();
+        if (loudness == UnknownLoudness) {
+            return m_gainDb;
+        }
+    }
+    return qBound(MinGainDb, m_target - loudness, MaxGainDb);
+}
@@ -0,0 +1,122 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOUDNESSNORMALIZER_H
+#define LOUDNESSNORMALIZER_H
+
+#include <QtCore/QtGlobal>
+
+#include "audionode.h"
+
+/**
+ * Measures the integrated loudness of a track as it plays (EBU R128:
+ * K-weighting, 400ms blocks every 100ms, absolute and relative gating) and
+ * applies the gain that brings it to the target loudness.
+ *
+ * If the loudness of the track is already known the right gain is applied
+ * from the first sample. Otherwise the gain follows the measurement as it
+ * settles, slowly enough not to be heard as pumping.
+ *
+ * Gated blocks are kept in a fixed histogram, so memory does not grow
+ * with the length of the track and nothing is allocated while playing.
+ */
+class LoudnessNormalizer
+    : public AudioNode
+{
+public:
+    static const int UnknownLoudness = -1000;
+
+    LoudnessNormalizer(int maxSamples);
+    ~LoudnessNormalizer();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void setTargetLoudness(double lufs);
+
+    /**
+     * Starts measuring a new track, of known loudness or UnknownLoudness.
+     */
+    void startTrack(double lufs);
+
+    /**
+     * Integrated loudness measured since startTrack(), or UnknownLoudness
+     * if there is not enough audio yet.
+     */
+    double measuredLoudness() const;
+
+    virtual const char *name() const;
+    virtual void setFormat(int sampleRate, int channels);
+
+    /**
+     * Clears the filter state, the measurement goes on.
+     */
+    virtual void reset();
+
+    /**
+     * Same as isEnabled().
+     */
+    virtual bool isActive() const;
+
+    /**
+     * Measures @p frames and applies the gain to them, in place.
+     */
+    virtual void process(float *data, int frames);
+
+private:
+    static const int MaxChannels = 8;
+    static const int HistogramBins = 750; ///< 0.1 LU wide, from -70 LUFS
+    static const double MaxGainDb;
+    static const double MinGainDb;
+    static const double SlewDbPerSecond;
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void measure(const float *data, int frames);
+    void addBlock();
+    double targetGainDb() const;
+
+    bool    m_enabled;
+    double  m_target;
+    int     m_sampleRate;
+    int     m_channels;
+    float  *m_scratch;
+
+    // K-weighting: high shelf followed by high pass, with state per channel
+    Biquad  m_shelf;
+    Biquad  m_highPass;
+    double  m_state[MaxChannels][4];
+
+    // 100ms sub-blocks; a gating block is the last four of them
+    int     m_subBlockFrames;
+    int     m_subBlockFill;
+    double  m_subBlockEnergy;
+    double  m_subBlocks[4];
+    int     m_subBlockCount;
+
+    double  m_histogramEnergy[HistogramBins];
+    int     m_histogramCount[HistogramBins];
+    qint64  m_measuredFrames;
+
+    double  m_knownLoudness;
+    double  m_gainDb;
+};
+
+#endif
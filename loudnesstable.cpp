@@ -0,0 +1,158 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loudnesstable.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+
+#include <KDebug>
+#include <KSaveFile>
+
+static const quint32 Magic = 0x53504b4c; // "SPKL"
+static const quint32 Version = 1;
+static const int HeaderSize = 8;  // magic and version
+static const int EntrySize = 10;
+
+LoudnessTable::LoudnessTable(const QString &fileName)
+    : m_fileName(fileName)
+    , m_fileEntries(-1)
+{
+    load();
+}
+
+bool LoudnessTable::lookup(const QByteArray &uri, double *lufs) const
+{
+    QHash<quint64, qint16>::const_iterator it = m_entries.constFind(hash(uri));
+    if (it == m_entries.constEnd()) {
+        return false;
+    }
+    *lufs = it.value() / 100.0;
+    return true;
+}
+
+void LoudnessTable::insert(const QByteArray &uri, double lufs)
+{
+    const qint16 value = qBound(-7000, qRound(lufs * 100.0), 3000);
+    const quint64 key = hash(uri);
+    if (m_entries.value(key, 0x7fff) == value) {
+        return;
+    }
+    m_entries.insert(key, value);
+    if (m_fileEntries > 2 * m_entries.count() + 64) {
+        save();
+    } else {
+        append(key, value);
+    }
+}
+
+quint64 LoudnessTable::hash(const QByteArray &uri)
+{
+    // 64 bit FNV-1a
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < uri.size(); ++i) {
+        hash ^= quint8(uri[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+void LoudnessTable::load()
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != Magic || version != Version) {
+        kWarning() << "Ignoring loudness table" << m_fileName << "with unknown format";
+        return;
+    }
+
+    const qint64 count = (file.size() - HeaderSize) / EntrySize;
+    for (qint64 i = 0; i < count; ++i) {
+        quint64 key;
+        qint16 value;
+        stream >> key >> value;
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        m_entries.insert(key, value);
+    }
+
+    // A partial entry at the end, from an append cut short, would throw
+    // off the ones appended after it
+    if ((file.size() - HeaderSize) % EntrySize || stream.status() != QDataStream::Ok) {
+        file.close();
+        save();
+        return;
+    }
+    m_fileEntries = count;
+}
+
+void LoudnessTable::save()
+{
+    m_fileEntries = -1;
+
+    KSaveFile file(m_fileName);
+    if (!file.open()) {
+        kWarning() << "Could not write loudness table" << m_fileName;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << Magic << Version;
+    QHash<quint64, qint16>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        stream << it.key() << it.value();
+    }
+    if (file.finalize()) {
+        m_fileEntries = m_entries.count();
+    }
+}
+
+void LoudnessTable::append(quint64 key, qint16 value)
+{
+    if (m_fileEntries < 0) {
+        save();
+        return;
+    }
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        kWarning() << "Could not write loudness table" << m_fileName;
+        return;
+    }
+    // Removed or replaced behind our back
+    if (file.size() != HeaderSize + qint64(m_fileEntries) * EntrySize) {
+        file.close();
+        save();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << key << value;
+    if (stream.status() == QDataStream::Ok && file.flush()) {
+        ++m_fileEntries;
+    } else {
+        m_fileEntries = -1;
+    }
+}
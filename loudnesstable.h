@@ -0,0 +1,57 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOUDNESSTABLE_H
+#define LOUDNESSTABLE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+
+/**
+ * Integrated loudness of the tracks that have been played to the end,
+ * keyed by track URI. On disk each entry takes 10 bytes: a 64 bit hash of
+ * the URI and the loudness in hundredths of LU.
+ *
+ * New entries are appended to the file, later ones replacing earlier ones
+ * on load. The whole file is only written again when it is damaged, or
+ * when replaced entries make up most of it.
+ */
+class LoudnessTable
+{
+public:
+    LoudnessTable(const QString &fileName);
+
+    bool lookup(const QByteArray &uri, double *lufs) const;
+    void insert(const QByteArray &uri, double lufs);
+
+private:
+    static quint64 hash(const QByteArray &uri);
+
+    void load();
+    void save();
+    void append(quint64 key, qint16 value);
+
+    QString                 m_fileName;
+    QHash<quint64, qint16>  m_entries;
+    // Entries in the file, replaced ones included, or -1 when it has to be
+    // written again before anything can be appended
+    int                     m_fileEntries;
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "playpausebutton.h"
 #include "trackviewdelegate.h"
 #include "blockanalyzer.h"
+#include "mainwindow.h"
 
 #include <math.h>
 
@@ -42,7 +43,6 @@
 
 MainWidget::MainWidget(QWidget *parent)
     : QWidget(parent)
-    , m_state(Stopped)
     , m_currentCollection(0)
     , m_currentPlayingCollection(0)
 {
@@ -75,7 +75,6 @@ MainWidget::MainWidget(QWidget *parent)
     connect(m_trackView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(trackRequested(QModelIndex)));
     connect(m_playPauseButton, SIGNAL(play()), this, SLOT(playSlot()));
     connect(m_playPauseButton, SIGNAL(pause()), this, SLOT(pauseSlot()));
-    connect(m_slider, SIGNAL(maximumReached()), this, SIGNAL(currentTrackFinished()));
     connect(m_slider, SIGNAL(seek(float)), this, SLOT(sliderSeekSlot(float)));
 
     QVBoxLayout *layout = new QVBoxLayout;
@@ -106,7 +105,6 @@ void MainWidget::loggedIn()
 
 void MainWidget::loggedOut()
 {
-    setState(Stopped);
     m_filter->setEnabled(false);
     m_filter->clear();
     m_trackView->setEnabled(false);
@@ -256,20 +254,6 @@ TrackView *MainWidget::trackView() const
     return m_trackView;
 }
 
-void MainWidget::setState(State state)
-{
-    if (state != Playing) {
-        emit pausedOrStopped();
-    }
-    m_state = state;
-    m_playPauseButton->setIsPlaying(state == Playing);
-}
-
-MainWidget::State MainWidget::state() const
-{
-    return m_state;
-}
-
 void MainWidget::highlightCurrentTrack(Focus focus)
 {
     if (!m_currentPlayingCollection) {
@@ -284,7 +268,8 @@ void MainWidget::highlightCurrentTrack(Focus focus)
 
 void MainWidget::setTotalTrackTime(int totalTrackTime)
 {
-    m_slider->setRange(0, totalTrackTime * (quint64) 44100);
+    // The slider counts microseconds, whatever the sample rate is
+    m_slider->setRange(0, totalTrackTime * (quint64) 1000);
     m_slider->setValue(0);
     m_slider->setCacheValue(0);
 
@@ -301,29 +286,11 @@ void MainWidget::setTotalTrackTime(int totalTrackTime)
 #endif
 }
 
-void MainWidget::advanceCurrentTrackTime(const Chunk &chunk)
+void MainWidget::setCurrentTrackTime(quint64 position)
 {
-    if (chunk.m_dataFrames == -1) {
-        m_slider->setValue(m_slider->maximum());
-        QTime val;
-        QTime total;
-        val = total.addMSecs(m_totalTrackTime);
-        total = val;
-#if KDE_IS_VERSION(4,5,66)
-        m_currTotalTime->setText(i18nc("Current time position, Total length","<b>%1</b><br/><b>%2</b>",
-                        KGlobal::locale()->formatLocaleTime(val, KLocale::TimeDuration | KLocale::TimeFoldHours),
-                        KGlobal::locale()->formatLocaleTime(total, KLocale::TimeDuration | KLocale::TimeFoldHours)));
-#else
-        m_currTotalTime->setText(i18nc("Current time position, Total length","<b>%1</b><br/><b>%2</b>",
-                        KGlobal::locale()->formatTime(val, true, true),
-                        KGlobal::locale()->formatTime(total, true, true)));
-#endif
-        return;
-    }
-
-    m_slider->setValue(m_slider->value() + chunk.m_dataFrames * 1000);
-    const int curpos = (quint64) ((m_slider->value() / (chunk.m_rate * 1000)));
-    const int totpos = (quint64) ((m_slider->maximum() / (chunk.m_rate * 1000)));
+    m_slider->setValue(qMin(position, m_slider->maximum()));
+    const int curpos = m_slider->value() / 1000000;
+    const int totpos = m_slider->maximum() / 1000000;
 
     QTime val;
     QTime total;
@@ -340,31 +307,23 @@ void MainWidget::advanceCurrentTrackTime(const Chunk &chunk)
 #endif
 }
 
-void MainWidget::advanceCurrentCacheTrackTime(const Chunk &chunk)
+void MainWidget::setCurrentCacheTrackTime(quint64 position)
 {
-    if (chunk.m_dataFrames != -1) {
-        m_slider->setCacheValue(m_slider->cacheValue() + chunk.m_dataFrames * 1000);
-    } else {
-        m_slider->setCacheValue(m_slider->maximum());
-    }
+    m_slider->setCacheValue(qMin(position, m_slider->maximum()));
 }
 
 void MainWidget::playSlot()
 {
-    if (m_state == Stopped) {
-        if (m_trackView->currentIndex().isValid()) {
-            trackRequested(m_trackView->currentIndex());
-        }
-    } else {
-        m_state = Playing;
+    if (MainWindow::self()->playerState().state() == PlayerState::Paused) {
         emit resume();
+    } else if (m_trackView->currentIndex().isValid()) {
+        trackRequested(m_trackView->currentIndex());
     }
 }
 
 void MainWidget::pauseSlot()
 {
-    m_state = Paused;
-    emit pausedOrStopped();
+    emit pause();
 }
 
 void MainWidget::trackRequested(const QModelIndex &index)
@@ -372,8 +331,6 @@ void MainWidget::trackRequested(const QModelIndex &index)
     if (!index.isValid()) {
         return;
     }
-    m_state = Playing;
-    m_playPauseButton->setIsPlaying(true);
     m_currentPlayingCollection = m_currentCollection;
     m_currentPlayingCollection->currentTrack = index.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
     emit play(index);
@@ -396,15 +353,22 @@ void MainWidget::sliderSeekSlot(float position)
 
 void MainWidget::togglePlayPauseSlot()
 {
-    if (m_state == Playing) {
+    if (MainWindow::self()->playerState().isActive()) {
         pauseSlot();
-        m_playPauseButton->setIsPlaying(false);
     } else {
         playSlot();
     }
 }
 
-void MainWidget::updateAnalyzer(const Chunk &chunk)
+void MainWidget::playerStateChanged(PlayerState::State state)
+{
+    // Changes made on the sound feeder thread arrive queued, go by what
+    // the player is doing now
+    Q_UNUSED(state);
+    m_playPauseButton->setIsPlaying(MainWindow::self()->playerState().isActive());
+}
+
+BlockAnalyzer *MainWidget::analyzer() const
 {
-    m_analyzer->drawFrame(chunk);
+    return m_analyzer;
 }
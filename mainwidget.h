@@ -20,6 +20,7 @@
 #define MAINWIDGET_H
 
 #include "chunk.h"
+#include "playerstate.h"
 #include "trackmodel.h"
 
 #include <QtCore/QModelIndex>
@@ -51,12 +52,6 @@ class MainWidget
     Q_OBJECT
 
 public:
-    enum State {
-        Stopped = 0,
-        Playing,
-        Paused
-    };
-
     enum Focus {
         SetFocus = 0,
         DoNotSetFocus = 1
@@ -101,24 +96,25 @@ public:
     void setCurrentPlayingCollection(Collection &collection);
     TrackView *trackView() const;
 
-    void setState(State state);
-    State state() const;
-
     void highlightCurrentTrack(Focus focus = SetFocus);
 
     void setTotalTrackTime(int totalTrackTime);
-    void advanceCurrentTrackTime(const Chunk &c);
-    void advanceCurrentCacheTrackTime(const Chunk &c);
+    /**
+     * Positions are in microseconds.
+     */
+    void setCurrentTrackTime(quint64 position);
+    void setCurrentCacheTrackTime(quint64 position);
+
+    BlockAnalyzer *analyzer() const;
 
 Q_SIGNALS:
     void play(const QModelIndex &index);
     void resume();
-    void pausedOrStopped();
+    void pause();
     void seekPosition(int position);
-    void currentTrackFinished();
 
 public Q_SLOTS:
-    void updateAnalyzer(const Chunk &chunk);
+    void playerStateChanged(PlayerState::State state);
 
 private Q_SLOTS:
     void playSlot();
@@ -130,7 +126,6 @@ private Q_SLOTS:
     void sliderSeekSlot(float position);
 
 private:
-    State                            m_state;
     KLineEdit                       *m_filter;
     TrackView                       *m_trackView;
     PlayPauseButton                 *m_playPauseButton;
@@ -18,15 +18,21 @@
 
 #include "mainwindow.h"
 #include "login.h"
+#include "audiosink.h"
+#include "nullsink.h"
 #include "trackview.h"
 #include "trackmodel.h"
 #include "coverlabel.h"
 #include "mainwidget.h"
 #include "soundfeeder.h"
+#include "spectrumthread.h"
+#include "blockanalyzer.h"
+#include "audiokernels.h"
 #include "playlistview.h"
 #include "playlistmodel.h"
 #include "searchhistorymodel.h"
 #include "scrobblingsettingsdialog.h"
+#include "equalizerdialog.h"
 #include "scrobbler.h"
 #include "lyricswidget.h"
 
@@ -45,10 +51,12 @@
 
 #include <KMenu>
 #include <KDebug>
+#include <KGlobal>
 #include <KAction>
 #include <KLocale>
 #include <KLineEdit>
 #include <KComboBox>
+#include <KConfigGroup>
 #include <KAboutData>
 #include <KStatusBar>
 #include <KPushButton>
@@ -62,6 +70,35 @@
 
 MainWindow *MainWindow::s_self = 0;
 
+// How long before the end of the delivered track the next one is prefetched
+static const quint64 PrefetchMicroseconds = 10000000;
+
+static double readMaxBufferedSeconds(const KConfigGroup &config)
+{
+    return qBound(0.5, config.readEntry("MaxBufferedSeconds", 3.0), 5.0);
+}
+
+static double readCrossfadeSeconds(const KConfigGroup &config)
+{
+    return qBound(0.0, config.readEntry("CrossfadeSeconds", 0.0), 12.0);
+}
+
+static double readHistorySeconds(const KConfigGroup &config)
+{
+    return qBound(0.0, config.readEntry("HistorySeconds", 30.0), 60.0);
+}
+
+// The PCM ring holds the buffered audio, the end of a track while it is
+// crossfaded and what has been played recently, at up to 48kHz stereo
+static int pcmRingCapacity()
+{
+    const KConfigGroup config(KGlobal::config(), "Audio");
+    const double seconds = readMaxBufferedSeconds(config) + readCrossfadeSeconds(config) + readHistorySeconds(config);
+    return seconds * 48000 * 2;
+}
+// Blocks in flight between the feeder, the analyzer and queued signals
+static const int PcmBlockPoolSize = 32;
+
 //BEGIN: SpotifySession - application bridge
 namespace SpotifySession {
 
@@ -157,18 +194,24 @@ namespace SpotifySession {
             return 0;
         }
 
-        const int numFrames = qMin(numFrames_, 8192);
-
-        QMutex &m = MainWindow::self()->dataMutex();
-        m.lock();
-        Chunk c;
-        c.m_data = malloc(numFrames * sizeof(int16_t) * format->channels);
-        memcpy(c.m_data, frames, numFrames * sizeof(int16_t) * format->channels);
-        c.m_dataFrames = numFrames;
-        c.m_rate = format->sample_rate;
-        MainWindow::self()->newChunk(c);
-        m.unlock();
-        MainWindow::self()->pcmWaitCondition().wakeAll();
+        // Only keep a few seconds buffered; when the ring is that full we
+        // take part or nothing of what is offered, and libspotify retries.
+        PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+        if (!ring.setFormat(format->sample_rate, format->channels)) {
+            return 0;
+        }
+        // The end of a track has to be in the ring a whole crossfade before
+        // it is played
+        const double seconds = MainWindow::self()->maxBufferedSeconds() + MainWindow::self()->crossfadeSeconds();
+        ring.setLimit(seconds * format->sample_rate * format->channels);
+        const int numFrames = ring.write(static_cast<const int16_t*>(frames), numFrames_);
+        if (numFrames) {
+            Chunk c;
+            c.m_dataFrames = numFrames;
+            c.m_rate = format->sample_rate;
+            c.m_channels = format->channels;
+            MainWindow::self()->signalNewChunk(c);
+        }
 
         return numFrames;
     }
@@ -216,7 +259,7 @@ namespace SpotifySession {
     static void getAudioBufferStats(sp_session *session, sp_audio_buffer_stats *stats)
     {
         Q_UNUSED(session);
-        Q_UNUSED(stats);
+        MainWindow::self()->audioBufferStats(&stats->samples, &stats->stutter);
     }
 #endif
 
@@ -576,8 +619,27 @@ namespace SpotifyImage {
 
 MainWindow::MainWindow(QWidget *parent)
     : KXmlGuiWindow(parent)
+    , m_audioSink(0)
+    , m_pcmRing(pcmRingCapacity())
+    , m_pcmBlockPool(SoundFeeder::BlockSamples, PcmBlockPoolSize)
     , m_soundFeeder(new SoundFeeder(this))
-    , m_isExiting(false)
+    , m_spectrumThread(new SpectrumThread(this))
+    , m_reportedUnderruns(0)
+    , m_maxBufferedSeconds(3.0)
+    , m_crossfadeSeconds(0)
+    , m_crossfadeCurve(Crossfader::EqualPower)
+    , m_normalizationEnabled(true)
+    , m_normalizationTarget(-14.0)
+    , m_equalizerEnabled(false)
+    , m_loudnessTable(KStandardDirs::locateLocal("appdata", "loudness"))
+    , m_playingTrack(0)
+    , m_playedWhole(false)
+    , m_loadedTrack(0)
+    , m_prefetchedTrack(0)
+    , m_queuedTrack(0)
+    , m_prefetchDone(false)
+    , m_deliveredPosition(0)
+    , m_loadGeneration(0)
     , m_pc(0)
     , m_currentPlaylist(0)
     , m_statusLabel(new QLabel(i18n("Ready"), this))
@@ -616,12 +678,15 @@ MainWindow::MainWindow(QWidget *parent)
     connect(this, SIGNAL(notifyMainThreadSignal()), this, SLOT(notifyMainThread()), Qt::QueuedConnection);
     connect(this, SIGNAL(newChunkReceived(Chunk)), this, SLOT(newChunkReceivedSlot(Chunk)), Qt::QueuedConnection);
     connect(this, SIGNAL(coverLoaded(QImage)), this, SLOT(coverLoadedSlot(QImage)), Qt::QueuedConnection);
-    connect(m_soundFeeder, SIGNAL(pcmWritten(Chunk)), this, SLOT(pcmWrittenSlot(Chunk)));
+    connect(m_soundFeeder, SIGNAL(pcmWritten()), this, SLOT(pcmWrittenSlot()));
+    connect(m_soundFeeder, SIGNAL(trackLoudnessMeasured(double)), this, SLOT(trackLoudnessMeasuredSlot(double)));
+    connect(m_soundFeeder, SIGNAL(trackBoundaryReached()), this, SLOT(trackBoundaryReachedSlot()));
     connect(m_mainWidget, SIGNAL(play(QModelIndex)), this, SLOT(playSlot(QModelIndex)));
     connect(m_mainWidget, SIGNAL(resume()), this, SLOT(resumeSlot()));
-    connect(m_mainWidget, SIGNAL(pausedOrStopped()), this, SLOT(pausedOrStoppedSlot()));
+    connect(m_mainWidget, SIGNAL(pause()), this, SLOT(pauseSlot()));
     connect(m_mainWidget, SIGNAL(seekPosition(int)), this, SLOT(seekPosition(int)));
-    connect(m_mainWidget, SIGNAL(currentTrackFinished()), this, SLOT(nextTrackSlot()));
+    connect(&m_playerState, SIGNAL(stateChanged(PlayerState::State)), this, SLOT(playerStateChangedSlot(PlayerState::State)));
+    connect(&m_playerState, SIGNAL(stateChanged(PlayerState::State)), m_mainWidget, SLOT(playerStateChanged(PlayerState::State)));
 
     setCentralWidget(m_mainWidget);
 
@@ -725,6 +790,10 @@ MainWindow::MainWindow(QWidget *parent)
 
     initSound();
     m_soundFeeder->start();
+    m_spectrumThread->setAnalyzer(m_mainWidget->analyzer());
+    // 15, 30 or 60 repaints a second
+    m_mainWidget->analyzer()->setFrameRate(KConfigGroup(KGlobal::config(), "Audio").readEntry("AnalyzerFrameRate", 30));
+    m_spectrumThread->start(QThread::LowPriority);
     
     Login *login = new Login(this);
     login->exec();
@@ -732,8 +801,18 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
-    m_isExiting = true;
-    m_pcmWaitCondition.wakeAll();
+    // Both threads check for exiting whenever they wake up, and they use
+    // the ring, the pool and the sink until they return
+    m_playerState.setExiting();
+    m_soundFeeder->stop();
+    m_soundFeeder->wakeUp();
+    m_spectrumTap.wakeUp();
+    m_spectrumThread->wait();
+    m_soundFeeder->wait();
+    dumpAudioStats();
+    // Queued chunks hold blocks of m_pcmBlockPool, drop them while it exists
+    QCoreApplication::removePostedEvents(this);
+    delete m_audioSink;
     if (m_loggedIn) {
         sp_session_logout(m_session);
     }
@@ -751,7 +830,7 @@ QSize MainWindow::sizeHint() const
 
 bool MainWindow::isExiting() const
 {
-    return m_isExiting;
+    return m_playerState.isExiting();
 }
 
 sp_session *MainWindow::session() const
@@ -796,7 +875,7 @@ void MainWindow::signalNotifyMainThread()
 
 bool MainWindow::isPlaying() const
 {
-    return m_mainWidget->state() == MainWidget::Playing;
+    return m_playerState.isActive();
 }
 
 void MainWindow::spotifyLoggedIn()
@@ -847,65 +926,128 @@ void MainWindow::showRequest(const QString &request)
     m_statusLabel->setText(request);
 }
 
-snd_pcm_t *MainWindow::pcmHandle() const
+AudioSink *MainWindow::audioSink() const
+{
+    return m_audioSink;
+}
+
+PcmRingBuffer &MainWindow::pcmRing()
 {
-    return m_snd;
+    return m_pcmRing;
 }
 
-QMutex &MainWindow::pcmMutex()
+PcmBlockPool &MainWindow::pcmBlockPool()
 {
-    return m_pcmMutex;
+    return m_pcmBlockPool;
 }
 
-QMutex &MainWindow::dataMutex()
+PlaybackClock &MainWindow::playbackClock()
 {
-    return m_dataMutex;
+    return m_playbackClock;
 }
 
-QWaitCondition &MainWindow::pcmWaitCondition()
+PlayerState &MainWindow::playerState()
 {
-    return m_pcmWaitCondition;
+    return m_playerState;
 }
 
-QWaitCondition &MainWindow::playCondition()
+SpectrumTap &MainWindow::spectrumTap()
 {
-    return m_playCondition;
+    return m_spectrumTap;
 }
 
-void MainWindow::newChunk(const Chunk &chunk)
+void MainWindow::signalNewChunk(const Chunk &chunk)
 {
-    m_data.enqueue(chunk);
     emit newChunkReceived(chunk);
 }
 
-void MainWindow::coverLoadedSlot(const QImage &cover)
+double MainWindow::maxBufferedSeconds() const
 {
-    m_coverLoading->stop();
-    m_cover->setPixmap(QPixmap::fromImage(cover));
+    return m_maxBufferedSeconds;
+}
+
+double MainWindow::crossfadeSeconds() const
+{
+    return m_crossfadeSeconds;
+}
+
+Crossfader::Curve MainWindow::crossfadeCurve() const
+{
+    return m_crossfadeCurve;
+}
+
+bool MainWindow::normalizationEnabled() const
+{
+    return m_normalizationEnabled;
+}
+
+double MainWindow::normalizationTarget() const
+{
+    return m_normalizationTarget;
+}
+
+bool MainWindow::equalizerEnabled() const
+{
+    return m_equalizerEnabled;
 }
 
-Chunk MainWindow::nextChunk()
+QList<Equalizer::Band> MainWindow::equalizerBands() const
 {
-    Chunk chunk = m_data.dequeue();
-    m_mainWidget->updateAnalyzer(chunk);
-    return chunk;
+    return m_equalizerBands;
 }
 
-bool MainWindow::hasChunk() const
+void MainWindow::setEqualizer(bool enabled, const QList<Equalizer::Band> &bands)
 {
-    return !m_data.isEmpty();
+    m_equalizerEnabled = enabled;
+    m_equalizerBands = bands;
+    m_soundFeeder->setEqualizer(enabled, bands);
+}
+
+void MainWindow::saveEqualizer()
+{
+    QList<int> types;
+    QList<int> frequencies;
+    QList<double> gains;
+    QList<double> q;
+    Q_FOREACH (const Equalizer::Band &band, m_equalizerBands) {
+        types << band.type;
+        frequencies << qRound(band.frequency);
+        gains << band.gain;
+        q << band.q;
+    }
+
+    KConfigGroup config(KGlobal::config(), "Equalizer");
+    config.writeEntry("Enabled", m_equalizerEnabled);
+    config.writeEntry("Types", types);
+    config.writeEntry("Frequencies", frequencies);
+    config.writeEntry("Gains", gains);
+    config.writeEntry("Q", q);
+    config.sync();
+}
+
+void MainWindow::audioBufferStats(int *frames, int *underruns)
+{
+    const qint64 sinkDelay = m_soundFeeder->sinkDelay();
+    *frames = m_pcmRing.framesQueued() + sinkDelay * m_pcmRing.writeSampleRate() / 1000000;
+
+    const int totalUnderruns = m_audioSink ? m_audioSink->underruns() : 0;
+    *underruns = totalUnderruns - m_reportedUnderruns;
+    m_reportedUnderruns = totalUnderruns;
+}
+
+void MainWindow::coverLoadedSlot(const QImage &cover)
+{
+    m_coverLoading->stop();
+    m_cover->setPixmap(QPixmap::fromImage(cover));
 }
 
 void MainWindow::endOfTrack()
 {
-    Chunk c;
-    c.m_data = 0;
-    c.m_dataFrames = -1;
-    c.m_rate = -1;
-    m_dataMutex.lock();
-    m_data.enqueue(c);
-    m_dataMutex.unlock();
-    m_mainWidget->advanceCurrentCacheTrackTime(c);
+    // Post to the main thread before the boundary goes into the ring, so the
+    // next track is always queued by the time the feeder reaches it.
+    QMetaObject::invokeMethod(this, "trackDeliveredSlot", Qt::QueuedConnection,
+                              Q_ARG(int, m_loadGeneration));
+    m_pcmRing.writeMarker(PcmRingBuffer::EndOfTrack);
 }
 
 void MainWindow::fillPlaylistModel()
@@ -1011,7 +1153,21 @@ void MainWindow::signalCoverLoaded(const QImage &cover)
 
 void MainWindow::newChunkReceivedSlot(const Chunk &chunk)
 {
-    m_mainWidget->advanceCurrentCacheTrackTime(chunk);
+    m_deliveredPosition += chunk.m_dataFrames * (quint64) 1000000 / chunk.m_rate;
+    if (!m_queuedTrack) {
+        m_mainWidget->setCurrentCacheTrackTime(m_deliveredPosition);
+    }
+
+    if (!m_prefetchDone && m_loadedTrack &&
+        m_deliveredPosition + PrefetchMicroseconds >= sp_track_duration(m_loadedTrack) * (quint64) 1000) {
+        m_prefetchDone = true;
+        m_prefetchedTrack = nextTrack(m_loadedTrack);
+#if SPOTIFY_API_VERSION >= 10
+        if (m_prefetchedTrack) {
+            sp_session_player_prefetch(m_session, m_prefetchedTrack);
+        }
+#endif
+    }
 }
 
 void MainWindow::loginSlot()
@@ -1043,23 +1199,30 @@ void MainWindow::playSlot(const QModelIndex &index)
     if (!index.isValid()) {
         return;
     }
-    m_previousTrack->setEnabled(true);
-    m_nextTrack->setEnabled(true);
     play(index.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>());
 }
 
 void MainWindow::resumeSlot()
 {
-    m_previousTrack->setEnabled(true);
-    m_nextTrack->setEnabled(true);
-    m_mainWidget->setState(MainWidget::Playing);
-    m_playCondition.wakeAll();
+    if (m_playerState.transition(PlayerState::Paused, PlayerState::Playing)) {
+        m_soundFeeder->resume();
+    }
 }
 
-void MainWindow::pausedOrStoppedSlot()
+void MainWindow::pauseSlot()
 {
-    m_previousTrack->setEnabled(false);
-    m_nextTrack->setEnabled(false);
+    if (m_playerState.isActive() && m_playerState.setState(PlayerState::Paused)) {
+        m_soundFeeder->pause();
+    }
+}
+
+void MainWindow::playerStateChangedSlot(PlayerState::State state)
+{
+    // May be queued from the sound feeder thread and stale by now
+    Q_UNUSED(state);
+    const bool active = m_playerState.isActive();
+    m_previousTrack->setEnabled(active);
+    m_nextTrack->setEnabled(active);
 }
 
 void MainWindow::performSearch()
@@ -1103,9 +1266,62 @@ void MainWindow::performSearch()
 #endif
 }
 
-void MainWindow::pcmWrittenSlot(const Chunk &chunk)
+void MainWindow::pcmWrittenSlot()
+{
+    m_mainWidget->setCurrentTrackTime(qMax<qint64>(m_playbackClock.position(), 0));
+}
+
+void MainWindow::trackDeliveredSlot(int loadGeneration)
+{
+    // Stale if another track was loaded since libspotify finished this one
+    if (loadGeneration != m_loadGeneration) {
+        return;
+    }
+
+    m_mainWidget->setCurrentCacheTrackTime(m_deliveredPosition);
+
+    sp_track *const track = m_prefetchDone ? m_prefetchedTrack : nextTrack(m_loadedTrack);
+    if (!track) {
+        return;
+    }
+
+    // Keep the device running and just append the next track to the ring
+    loadTrack(track);
+    m_queuedTrack = track;
+    m_soundFeeder->setNextTrackLoudness(storedLoudness(track));
+}
+
+void MainWindow::trackLoudnessMeasuredSlot(double lufs)
+{
+    if (!m_playingTrack || !m_playedWhole) {
+        return;
+    }
+    const QByteArray uri = trackUri(m_playingTrack);
+    if (!uri.isEmpty()) {
+        m_loudnessTable.insert(uri, lufs);
+    }
+}
+
+void MainWindow::trackBoundaryReachedSlot()
 {
-    m_mainWidget->advanceCurrentTrackTime(chunk);
+    if (!m_queuedTrack) {
+        m_mainWidget->setCurrentTrackTime(m_deliveredPosition);
+        m_playerState.setState(PlayerState::Ended);
+        return;
+    }
+
+    // Scrobble the song that just finished
+    emit scrobble();
+
+    sp_track *const track = m_queuedTrack;
+    m_queuedTrack = 0;
+    MainWidget::Collection *const c = m_mainWidget->currentPlayingCollection();
+    if (c) {
+        c->currentTrack = track;
+    }
+    m_mainWidget->trackView()->highlightTrack(track);
+    showTrack(track);
+    m_mainWidget->setCurrentCacheTrackTime(m_deliveredPosition);
 }
 
 void MainWindow::playlistChanged(const QItemSelection &selection)
@@ -1207,14 +1423,36 @@ void MainWindow::searchHistoryChanged(const QItemSelection &selection)
 
 void MainWindow::seekPosition(int position)
 {
-    m_pcmMutex.lock();
-    snd_pcm_drop(m_snd);
-    while (!m_data.isEmpty()) {
-        Chunk c = m_data.dequeue();
-        free(c.m_data);
+    // Nothing to seek in once stopped
+    if (!m_loadedTrack) {
+        return;
+    }
+
+    m_playedWhole = false;
+    // Paused stays paused, the new position is heard on resume
+    if (!m_playerState.transition(PlayerState::Playing, PlayerState::Seeking)) {
+        m_playerState.transition(PlayerState::Buffering, PlayerState::Seeking);
+    }
+
+    // Going back to something played a moment ago needs no round trip to
+    // libspotify; delivery carries on from where it was
+    if (m_soundFeeder->seekBack(position * (qint64) 1000)) {
+        return;
+    }
+
+    // With the next track loaded already libspotify would seek that one;
+    // go back to the track being shown, and prefetch again from there
+    if (m_loadedTrack != m_playingTrack) {
+        sp_session_player_play(m_session, false);
+        sp_session_player_unload(m_session);
+        m_queuedTrack = 0;
+        loadTrack(m_playingTrack);
+        m_soundFeeder->setNextTrackLoudness(LoudnessNormalizer::UnknownLoudness);
     }
-    snd_pcm_prepare(m_snd);
-    m_pcmMutex.unlock();
+
+    m_pcmRing.discard();
+    m_soundFeeder->seek(position * (qint64) 1000);
+    m_deliveredPosition = position * (quint64) 1000;
     sp_session_player_seek(m_session, position);
 }
 
@@ -1224,14 +1462,11 @@ void MainWindow::playPlaylist(const QModelIndex &index)
     if (!sp_playlist_num_tracks(playlist)) {
         return;
     }
-    m_previousTrack->setEnabled(true);
-    m_nextTrack->setEnabled(true);
     MainWidget::Collection &c = m_mainWidget->collection(playlist);
     const QModelIndex currentIndex = c.proxyModel->index(0, 0);
     c.currentTrack = currentIndex.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
     m_mainWidget->setCurrentPlayingCollection(c);
     m_mainWidget->trackView()->highlightTrack(c.currentTrack);
-    m_mainWidget->setState(MainWidget::Playing);
     play(c.currentTrack);
 }
 
@@ -1241,14 +1476,11 @@ void MainWindow::playSearchHistory(const QModelIndex &index)
     if (!sp_search_num_tracks(search)) {
         return;
     }
-    m_previousTrack->setEnabled(true);
-    m_nextTrack->setEnabled(true);
     MainWidget::Collection &c = m_mainWidget->collection(search);
     const QModelIndex currentIndex = c.proxyModel->index(0, 0);
     c.currentTrack = currentIndex.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
     m_mainWidget->setCurrentPlayingCollection(c);
     m_mainWidget->trackView()->highlightTrack(c.currentTrack);
-    m_mainWidget->setState(MainWidget::Playing);
     play(c.currentTrack);
 }
 
@@ -1280,6 +1512,7 @@ void MainWindow::coverClickedSlot()
 
 void MainWindow::clearAllWidgets()
 {
+    m_playerState.setState(PlayerState::Stopped);
     m_playlistModel->removeRows(0, m_playlistModel->rowCount());
     m_playlistView->setEnabled(false);
     m_searchHistoryModel->removeRows(0, m_searchHistoryModel->rowCount());
@@ -1315,7 +1548,6 @@ void MainWindow::previousTrackSlot()
         c->currentTrack = index.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
     }
     m_mainWidget->trackView()->highlightTrack(c->currentTrack);
-    m_mainWidget->setState(MainWidget::Playing);
     play(c->currentTrack);
 }
 
@@ -1325,18 +1557,46 @@ void MainWindow::setupScrobblingSlot()
     dialog->show();
 }
 
+void MainWindow::setupEqualizerSlot()
+{
+    EqualizerDialog *dialog = new EqualizerDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
 void MainWindow::play(sp_track *tr)
 {
     // Scrobble the currently playing song
     emit scrobble();
 
-    m_previousTrack->setEnabled(true);
-    m_nextTrack->setEnabled(true);
-
     clearSoundQueue();
-    m_pcmMutex.lock();
-    snd_pcm_prepare(m_snd);
-    m_pcmMutex.unlock();
+
+    m_playerState.setState(PlayerState::Loading);
+    showTrack(tr);
+    loadTrack(tr);
+    // Playing once its first audio is written
+    m_playerState.setState(PlayerState::Buffering);
+    m_soundFeeder->setTrackLoudness(storedLoudness(tr));
+    m_soundFeeder->setNextTrackLoudness(LoudnessNormalizer::UnknownLoudness);
+}
+
+void MainWindow::loadTrack(sp_track *tr)
+{
+    m_loadGeneration.ref();
+    m_loadedTrack = tr;
+    m_prefetchedTrack = 0;
+    m_prefetchDone = false;
+    m_deliveredPosition = 0;
+
+    sp_session_player_load(m_session, tr);
+    sp_session_player_play(m_session, true);
+}
+
+void MainWindow::showTrack(sp_track *tr)
+{
+    m_playingTrack = tr;
+    m_playedWhole = true;
+
     m_coverLoading->start();
     m_cover->clear();
     m_cover->setMovie(m_coverLoading);
@@ -1349,8 +1609,6 @@ void MainWindow::play(sp_track *tr)
 #endif
     sp_image *const cover = sp_image_create(m_session, image);
     sp_image_add_load_callback(cover, &SpotifyImage::imageLoaded, tr);
-    sp_session_player_load(m_session, tr);
-    sp_session_player_play(m_session, true);
     m_mainWidget->setTotalTrackTime(sp_track_duration(tr));
 
     // Set the currently playing song
@@ -1358,29 +1616,61 @@ void MainWindow::play(sp_track *tr)
     QString track = QString::fromUtf8(sp_track_name(tr));
     uint duration = sp_track_duration(tr);
     emit nowPlaying(artist, track, duration);
-
-    m_playCondition.wakeAll();
 }
 
 void MainWindow::nextTrackSlot()
 {
-    m_mainWidget->setState(MainWidget::Stopped);
+    MainWidget::Collection *const c = m_mainWidget->currentPlayingCollection();
+    sp_track *const track = c ? nextTrack(c->currentTrack) : 0;
+    if (!track) {
+        clearSoundQueue();
+        m_playerState.setState(PlayerState::Stopped);
+        return;
+    }
+
+    c->currentTrack = track;
+    m_mainWidget->trackView()->highlightTrack(c->currentTrack);
+    play(c->currentTrack);
+}
 
+double MainWindow::storedLoudness(sp_track *track) const
+{
+    double lufs;
+    if (!m_normalizationEnabled || !m_loudnessTable.lookup(trackUri(track), &lufs)) {
+        return LoudnessNormalizer::UnknownLoudness;
+    }
+    return lufs;
+}
+
+QByteArray MainWindow::trackUri(sp_track *track)
+{
+    sp_link *const link = sp_link_create_from_track(track, 0);
+    if (!link) {
+        return QByteArray();
+    }
+    char uri[256];
+    const int length = sp_link_as_string(link, uri, sizeof(uri));
+    sp_link_release(link);
+    return QByteArray(uri, qBound(0, length, int(sizeof(uri)) - 1));
+}
+
+sp_track *MainWindow::nextTrack(sp_track *after)
+{
     MainWidget::Collection *const c = m_mainWidget->currentPlayingCollection();
     if (!c) {
-        return;
+        return 0;
     }
     QSortFilterProxyModel *const proxyModel = c->proxyModel;
     if (proxyModel->rowCount() == 0) {
-        return;
+        return 0;
     }
 
     QModelIndex nextIndex = proxyModel->index(0, 0);
 
-    int row = c->rowForTrack(c->currentTrack);
+    int row = c->rowForTrack(after);
     if (row > -1) {
         if (!repeatIsOn() && !shuffleIsOn() && row == proxyModel->rowCount() - 1) {
-            return;
+            return 0;
         }
 
         int nNewTrackNum = row + 1;
@@ -1390,57 +1680,173 @@ void MainWindow::nextTrackSlot()
         nextIndex = proxyModel->index(nNewTrackNum % proxyModel->rowCount(), 0);
     }
 
-    c->currentTrack = nextIndex.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
-    m_mainWidget->trackView()->highlightTrack(c->currentTrack);
-    m_mainWidget->setState(MainWidget::Playing);
-    play(c->currentTrack);
+    return nextIndex.data(TrackModel::SpotifyNativeTrackRole).value<sp_track*>();
 }
 
 void MainWindow::initSound()
 {
-    int d = 0;
-    snd_pcm_uframes_t periodSize = 1024;
-    snd_pcm_uframes_t bufferSize = periodSize * 4;
-
-    snd_pcm_hw_params_t *hwParams;
-    snd_pcm_open(&m_snd, "default", SND_PCM_STREAM_PLAYBACK, 0);
-    snd_pcm_hw_params_malloc(&hwParams);
-    snd_pcm_hw_params_any(m_snd, hwParams);
-    snd_pcm_hw_params_set_access(m_snd, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(m_snd, hwParams, SND_PCM_FORMAT_S16_LE);
-    snd_pcm_hw_params_set_rate(m_snd, hwParams, 44100, 0);
-    snd_pcm_hw_params_set_channels(m_snd, hwParams, 2);
-    snd_pcm_hw_params_set_period_size_near(m_snd, hwParams, &periodSize, &d);
-    snd_pcm_hw_params_set_buffer_size_near(m_snd, hwParams, &bufferSize);
-    snd_pcm_hw_params(m_snd, hwParams);
-    snd_pcm_hw_params_free(hwParams);
-
-    snd_pcm_sw_params_t *swParams;
-    snd_pcm_sw_params_malloc(&swParams);
-    snd_pcm_sw_params_current(m_snd, swParams);
-    snd_pcm_sw_params_set_avail_min(m_snd, swParams, periodSize);
-    snd_pcm_sw_params_set_start_threshold(m_snd, swParams, 0);
-    snd_pcm_sw_params(m_snd, swParams);
-    snd_pcm_sw_params_free(swParams);
-
-    snd_pcm_prepare(m_snd);
+    const KConfigGroup config(KGlobal::config(), "Audio");
+    m_maxBufferedSeconds = readMaxBufferedSeconds(config);
+    m_crossfadeSeconds = readCrossfadeSeconds(config);
+    // Seeking back within the last HistorySeconds is served from memory
+    m_pcmRing.setHistory(readHistorySeconds(config) * 48000 * 2);
+    m_crossfadeCurve = config.readEntry("CrossfadeCurve", "equalpower") == "linear" ? Crossfader::Linear
+                                                                                    : Crossfader::EqualPower;
+
+    // Never normalize twice: either libspotify does it or we do
+    const QString normalization = config.readEntry("Normalization", "spokify");
+    m_normalizationEnabled = normalization == "spokify";
+    m_normalizationTarget = qBound(-30.0, config.readEntry("NormalizationTarget", -14.0), -5.0);
+#if SPOTIFY_API_VERSION >= 11
+    sp_session_set_volume_normalization(m_session, normalization == "spotify");
+#endif
+
+    // Ten bands an octave apart, shelving at both ends
+    const KConfigGroup equalizerConfig(KGlobal::config(), "Equalizer");
+    QList<int> defaultTypes;
+    QList<int> defaultFrequencies;
+    QList<double> defaultGains;
+    QList<double> defaultQ;
+    static const int octaves[] = { 31, 62, 125, 250, 500, 1000, 2000, 4000, 8000, 16000 };
+    for (int i = 0; i < 10; ++i) {
+        defaultTypes << (i == 0 ? Equalizer::LowShelf : i == 9 ? Equalizer::HighShelf : Equalizer::Peaking);
+        defaultFrequencies << octaves[i];
+        defaultGains << 0.0;
+        defaultQ << (i == 0 || i == 9 ? 0.71 : 1.41);
+    }
+    const QList<int> types = equalizerConfig.readEntry("Types", defaultTypes);
+    const QList<int> frequencies = equalizerConfig.readEntry("Frequencies", defaultFrequencies);
+    const QList<double> gains = equalizerConfig.readEntry("Gains", defaultGains);
+    const QList<double> q = equalizerConfig.readEntry("Q", defaultQ);
+    QList<Equalizer::Band> bands;
+    for (int i = 0; i < qMin(frequencies.count(), int(Equalizer::MaxBands)); ++i) {
+        Equalizer::Band band;
+        band.type = Equalizer::BandType(qBound(0, types.value(i), 2));
+        band.frequency = qBound(20, frequencies[i], 20000);
+        band.gain = qBound(-12.0, gains.value(i), 12.0);
+        band.q = qBound(0.1, q.value(i, 1.41), 10.0);
+        bands << band;
+    }
+    setEqualizer(equalizerConfig.readEntry("Enabled", false), bands);
+
+    // Opt in, as real time scheduling needs limits.conf or rtkit to allow it
+    m_soundFeeder->setScheduling(config.readEntry("RealTime", false),
+                                 config.readEntry("RealTimePolicy", "fifo") == "rr",
+                                 config.readEntry("RealTimePriority", 10),
+                                 config.readEntry("FeederCpu", -1));
+
+    // Balanced is what the sink always used; adaptive starts out there too
+    const QString latency = config.readEntry("LatencyProfile", "balanced");
+    const LatencyTuner::Profile latencyProfile = latency == "lowlatency" ? LatencyTuner::LowLatency :
+                                                 latency == "powersave"  ? LatencyTuner::PowerSave :
+                                                 latency == "adaptive"   ? LatencyTuner::Adaptive
+                                                                         : LatencyTuner::Balanced;
+    m_soundFeeder->setLatencyProfile(latencyProfile);
+
+    m_audioSink = AudioSink::create();
+    m_audioSink->setBuffering(LatencyTuner::initialPeriodFrames(latencyProfile), LatencyTuner::Periods);
+    if (!m_audioSink->open(AudioSink::Format(44100, 2))) {
+        // Keep playing in time, so that the rest of the player still works
+        kWarning() << "Could not open the audio output, playing silently";
+        delete m_audioSink;
+        m_audioSink = new NullSink(NullSink::RealTime);
+        m_audioSink->setBuffering(LatencyTuner::initialPeriodFrames(latencyProfile), LatencyTuner::Periods);
+        m_audioSink->open(AudioSink::Format(44100, 2));
+    }
 }
 
 void MainWindow::clearSoundQueue()
 {
-    m_dataMutex.lock();
-    if (isPlaying()) {
+    // Paused, ended or stopped, a loaded track may still have audio and
+    // markers in the ring
+    if (m_loadedTrack) {
         sp_session_player_play(m_session, false);
         sp_session_player_unload(m_session);
-        m_pcmMutex.lock();
-        snd_pcm_drop(m_snd);
-        m_pcmMutex.unlock();
-        while (!m_data.isEmpty()) {
-            Chunk c = m_data.dequeue();
-            free(c.m_data);
+        m_loadedTrack = 0;
+        m_queuedTrack = 0;
+        // Deliveries still queued are for the unloaded track
+        m_loadGeneration.ref();
+    }
+    m_pcmRing.discard();
+    // Even if there was nothing to clear, to end a pause
+    m_soundFeeder->stop();
+}
+
+void MainWindow::dumpAudioStats()
+{
+    // Without a Spotify session the sound was never set up
+    if (!m_audioSink) {
+        return;
+    }
+
+    const PcmBlockPool::Stats stats = m_pcmBlockPool.stats();
+    kDebug() << "PCM block pool:" << stats.blocks << "blocks," << stats.inUse << "in use,"
+             << stats.acquisitions << "acquisitions," << stats.heapAllocations << "heap allocations since startup";
+    const SoundFeeder::Stats feederStats = m_soundFeeder->stats();
+    kDebug() << "Sound feeder:" << feederStats.ringWaits << "waits for audio," << feederStats.deviceWaits << "waits for device,"
+             << feederStats.writes << "writes of" << feederStats.minWriteFrames << "to" << feederStats.maxWriteFrames << "frames,"
+             << feederStats.framesWritten << "frames written";
+    const AudioGraph &graph = m_soundFeeder->audioGraph();
+    for (int i = 0; i < graph.nodeCount(); ++i) {
+        const AudioGraph::NodeStats nodeStats = graph.nodeStats(i);
+        if (nodeStats.frames) {
+            kDebug() << "Audio graph:" << nodeStats.name << nodeStats.frames << "frames,"
+                     << double(nodeStats.microseconds) * 1000 / nodeStats.frames << "nanoseconds of CPU per frame";
         }
     }
-    m_dataMutex.unlock();
+    kDebug() << "Audio graph:" << graph.compilations() << "schedules compiled," << feederStats.crossfades << "crossfades,"
+             << feederStats.equalizerBands << "equalizer bands, using" << AudioKernels::instructionSet();
+    if (feederStats.historySeeks) {
+        kDebug() << "Seeks from history:" << feederStats.historySeeks << "taking"
+                 << feederStats.historySeekMicroseconds / feederStats.historySeeks << "microseconds on average";
+    }
+    if (feederStats.streamSeeks) {
+        kDebug() << "Seeks through libspotify:" << feederStats.streamSeeks << "taking"
+                 << feederStats.streamSeekMicroseconds / feederStats.streamSeeks << "microseconds on average";
+    }
+    if (feederStats.skips) {
+        kDebug() << "Track changes:" << feederStats.skips << "taking"
+                 << feederStats.skipMicroseconds / feederStats.skips << "microseconds on average";
+    }
+    if (feederStats.pauses) {
+        kDebug() << "Pauses:" << feederStats.pauses << "taking"
+                 << feederStats.pauseMicroseconds / feederStats.pauses << "microseconds on average";
+    }
+    if (feederStats.resumes) {
+        kDebug() << "Resumes:" << feederStats.resumes << "taking"
+                 << feederStats.resumeMicroseconds / feederStats.resumes << "microseconds on average";
+    }
+    // Out of the ring a frame is copied into a block and from there into the
+    // sink, or read straight into the sink's buffer
+    const qint64 sinkFrames = feederStats.copiedFrames + feederStats.directFrames;
+    if (sinkFrames) {
+        kDebug() << "Sound feeder:" << feederStats.directFrames << "frames written in place,"
+                 << feederStats.copiedFrames << "copied into the sink,"
+                 << double(2 * feederStats.copiedFrames + feederStats.directFrames) / sinkFrames
+                 << "copies per frame after the ring";
+    }
+    static const char *const schedulings[] = { "normal", "raised nice level", "real time" };
+    kDebug() << "Sound feeder:" << schedulings[feederStats.scheduling] << "scheduling,"
+             << (feederStats.memoryLocked ? "buffers locked in memory" : "buffers not locked in memory");
+    kDebug() << "Audio sink:" << m_audioSink->underruns() << "underruns since startup,"
+             << (m_audioSink->hasDirectAccess() ? "memory mapped" : "copying writes");
+    if (m_audioSink->recoveries()) {
+        kDebug() << "Audio sink:" << m_audioSink->recoveries() << "recoveries taking"
+                 << m_audioSink->recoveryMicroseconds() / m_audioSink->recoveries() << "microseconds on average,"
+                 << m_audioSink->longestRecoveryMicroseconds() << "at most";
+    }
+    kDebug() << "Audio sink:" << m_audioSink->bufferSize() << "frames of buffer," << feederStats.closeCalls << "close calls,"
+             << feederStats.bufferChanges << "buffer size changes";
+    const PcmRingBuffer::Stats ringStats = m_pcmRing.stats();
+    kDebug() << "PCM ring:" << ringStats.highWatermark << "samples high watermark," << ringStats.lowWatermark << "low watermark,"
+             << ringStats.fullWrites << "deliveries cut short by the" << m_maxBufferedSeconds << "seconds limit";
+    kDebug() << "Spectrum tap:" << m_spectrumTap.pushed() << "chunks," << m_spectrumTap.dropped() << "dropped,"
+             << m_spectrumThread->frames() << "analyzed," << m_mainWidget->analyzer()->spectra() << "spectra computed,"
+             << m_mainWidget->analyzer()->droppedSpectra() << "skipped since startup";
+    const Analyzer::Base::RenderStats render = m_mainWidget->analyzer()->renderStats();
+    kDebug() << "Analyzer at" << m_mainWidget->analyzer()->frameRate() << "fps:" << render.frames << "frames,"
+             << render.skipped << "skipped unchanged," << render.averageMicroseconds << "microseconds on average,"
+             << render.maxMicroseconds << "at most";
 }
 
 QWidget *MainWindow::createSearchWidget()
@@ -1518,6 +1924,12 @@ void MainWindow::setupActions()
     actionCollection()->addAction("setupScrobbling", m_setupScrobbling);
     connect(m_setupScrobbling, SIGNAL(triggered(bool)), this, SLOT(setupScrobblingSlot()));
 
+    m_setupEqualizer = new KAction(this);
+    m_setupEqualizer->setText(i18n("&Equalizer..."));
+    m_setupEqualizer->setIcon(KIcon("view-media-equalizer"));
+    actionCollection()->addAction("setupEqualizer", m_setupEqualizer);
+    connect(m_setupEqualizer, SIGNAL(triggered(bool)), this, SLOT(setupEqualizerSlot()));
+
     m_pause = new KAction(this);
     m_pause->setText(i18n("&Pause"));
     m_pause->setIcon(KIcon("media-playback-pause"));
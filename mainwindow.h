@@ -22,17 +22,22 @@
 #include <KXmlGuiWindow>
 
 #include "chunk.h"
-
-#include <QtCore/QMutex>
-#include <QtCore/QQueue>
+#include "pcmringbuffer.h"
+#include "pcmblockpool.h"
+#include "playbackclock.h"
+#include "playerstate.h"
+#include "spectrumtap.h"
+#include "crossfader.h"
+#include "equalizer.h"
+#include "loudnesstable.h"
+
+#include <QtCore/QAtomicInt>
 #include <QtCore/QBuffer>
+#include <QtCore/QList>
 #include <QtCore/QModelIndex>
-#include <QtCore/QWaitCondition>
 
 #include <QtGui/QItemSelection>
 
-#include <alsa/asoundlib.h>
-
 #include "appkey.h"
 #include <libspotify/api.h>
 
@@ -48,9 +53,11 @@ class KLineEdit;
 class KPushButton;
 class KStatusNotifierItem;
 
+class AudioSink;
 class CoverLabel;
 class MainWidget;
 class SoundFeeder;
+class SpectrumThread;
 class PlaylistView;
 class PlaylistModel;
 class SearchHistoryModel;
@@ -87,7 +94,6 @@ public:
 
     void signalCoverLoaded(const QImage &cover);
 
-    void setIsPlaying(bool isPlaying);
     bool isPlaying() const;
 
     void spotifyLoggedIn();
@@ -100,21 +106,56 @@ public:
 
     void showRequest(const QString &request);
 
-    snd_pcm_t *pcmHandle() const;
+    AudioSink *audioSink() const;
+
+    PcmRingBuffer &pcmRing();
+
+    PcmBlockPool &pcmBlockPool();
 
-    QMutex &pcmMutex();
+    PlaybackClock &playbackClock();
 
-    QMutex &dataMutex();
+    PlayerState &playerState();
 
-    QWaitCondition &pcmWaitCondition();
+    SpectrumTap &spectrumTap();
 
-    QWaitCondition &playCondition();
+    void signalNewChunk(const Chunk &chunk);
 
-    void newChunk(const Chunk &chunk);
+    /**
+     * Frames buffered between libspotify and the speakers, at the rate
+     * libspotify delivers, and sink underruns since the previous call.
+     * Called from the libspotify thread.
+     */
+    void audioBufferStats(int *frames, int *underruns);
 
-    Chunk nextChunk();
+    /**
+     * How much audio musicDelivery accepts ahead of playback, from the
+     * MaxBufferedSeconds entry of the "Audio" config group.
+     */
+    double maxBufferedSeconds() const;
 
-    bool hasChunk() const;
+    /**
+     * Crossfade between consecutive tracks, from the CrossfadeSeconds and
+     * CrossfadeCurve entries of the "Audio" config group. 0 disables it.
+     */
+    double crossfadeSeconds() const;
+    Crossfader::Curve crossfadeCurve() const;
+
+    /**
+     * Whether Spokify normalizes loudness itself, from the Normalization
+     * entry of the "Audio" config group: "spokify" (default), "spotify" to
+     * leave it to libspotify, or "off".
+     */
+    bool normalizationEnabled() const;
+    double normalizationTarget() const;
+
+    /**
+     * Equalizer bands, from the "Equalizer" config group. Setting them
+     * takes effect right away; saveEqualizer() makes them stick.
+     */
+    bool equalizerEnabled() const;
+    QList<Equalizer::Band> equalizerBands() const;
+    void setEqualizer(bool enabled, const QList<Equalizer::Band> &bands);
+    void saveEqualizer();
 
     void endOfTrack();
 
@@ -144,9 +185,13 @@ private Q_SLOTS:
     void logoutSlot();
     void playSlot(const QModelIndex &index);
     void resumeSlot();
-    void pausedOrStoppedSlot();
+    void pauseSlot();
+    void playerStateChangedSlot(PlayerState::State state);
     void performSearch();
-    void pcmWrittenSlot(const Chunk &chunk);
+    void pcmWrittenSlot();
+    void trackDeliveredSlot(int loadGeneration);
+    void trackBoundaryReachedSlot();
+    void trackLoudnessMeasuredSlot(double lufs);
     void playlistChanged(const QItemSelection &selection);
     void searchHistoryChanged(const QItemSelection &selection);
     void seekPosition(int position);
@@ -157,25 +202,65 @@ private Q_SLOTS:
     void clearAllWidgets();
     void previousTrackSlot();
     void setupScrobblingSlot();
+    void setupEqualizerSlot();
 
 private:
     void play(sp_track *track);
+    void loadTrack(sp_track *track);
+    void showTrack(sp_track *track);
+    /**
+     * The track that follows @p after in the playing collection, honouring
+     * shuffle and repeat, or 0 at the end.
+     */
+    sp_track *nextTrack(sp_track *after);
+    double storedLoudness(sp_track *track) const;
+    static QByteArray trackUri(sp_track *track);
     void initSound();
     void clearSoundQueue();
+    /**
+     * Writes what the audio path counted since startup to the debug
+     * output.
+     */
+    void dumpAudioStats();
     QWidget *createSearchWidget();
     QWidget *createCoverWidget();
     QWidget *createLyricsWidget();
     void setupActions();
 
 private:
-    snd_pcm_t            *m_snd;
-    QMutex                m_pcmMutex;
-    QMutex                m_dataMutex;
-    QWaitCondition        m_pcmWaitCondition;
-    QWaitCondition        m_playCondition;
-    QQueue<Chunk>         m_data;
+    AudioSink            *m_audioSink;
+    PcmRingBuffer         m_pcmRing;
+    PcmBlockPool          m_pcmBlockPool;
+    // Holds blocks of m_pcmBlockPool, so it goes first
+    SpectrumTap           m_spectrumTap;
+    PlaybackClock         m_playbackClock;
+    PlayerState           m_playerState;
+
     SoundFeeder          *m_soundFeeder;
-    bool                  m_isExiting;
+    SpectrumThread       *m_spectrumThread;
+    int                   m_reportedUnderruns;
+    double                m_maxBufferedSeconds;
+    double                m_crossfadeSeconds;
+    Crossfader::Curve     m_crossfadeCurve;
+    bool                  m_normalizationEnabled;
+    double                m_normalizationTarget;
+    bool                  m_equalizerEnabled;
+    QList<Equalizer::Band> m_equalizerBands;
+    LoudnessTable         m_loudnessTable;
+    // The track shown as playing, and whether it has been played through
+    // from the start without seeking, so its measured loudness can be kept
+    sp_track             *m_playingTrack;
+    bool                  m_playedWhole;
+
+    // Gapless playback. The loaded track is the one libspotify delivers;
+    // the queued track has been loaded after it and is waiting for the
+    // feeder to reach the boundary before the UI switches to it.
+    sp_track             *m_loadedTrack;
+    sp_track             *m_prefetchedTrack;
+    sp_track             *m_queuedTrack;
+    bool                  m_prefetchDone;
+    quint64               m_deliveredPosition;
+    QAtomicInt            m_loadGeneration;
 
     sp_session_config     m_config;
     sp_session           *m_session;
@@ -190,6 +275,7 @@ private:
     KAction              *m_previousTrack;
     KAction              *m_nextTrack;
     KAction              *m_setupScrobbling;
+    KAction              *m_setupEqualizer;
     KAction              *m_pause;
     QLabel               *m_statusLabel;
     QProgressBar         *m_progress;
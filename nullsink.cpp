@@ -0,0 +1,158 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nullsink.h"
+
+#include <time.h>
+#include <unistd.h>
+
+static qint64 monotonicMicroseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+NullSink::NullSink(Pace pace)
+    : m_pace(pace)
+    , m_queued(0)
+    , m_lastUpdate(0)
+    , m_remainder(0)
+    , m_paused(false)
+{
+}
+
+NullSink::~NullSink()
+{
+}
+
+bool NullSink::open(const Format &format)
+{
+    m_format = format;
+    drop();
+    recordBufferSize(m_pace == RealTime ? BufferSize : 0);
+    return true;
+}
+
+void NullSink::close()
+{
+    drop();
+}
+
+AudioSink::Format NullSink::format() const
+{
+    return m_format;
+}
+
+int NullSink::periodSize() const
+{
+    return PeriodSize;
+}
+
+int NullSink::avail()
+{
+    if (m_pace == AsFastAsPossible) {
+        return BufferSize;
+    }
+    advance();
+    return BufferSize - m_queued;
+}
+
+bool NullSink::wait(int timeout)
+{
+    if (m_pace == AsFastAsPossible) {
+        return true;
+    }
+    advance();
+    const qint64 missing = PeriodSize - (BufferSize - m_queued);
+    if (missing <= 0) {
+        return true;
+    }
+    qint64 sleep = missing * 1000000 / m_format.sampleRate;
+    if (timeout >= 0) {
+        sleep = qMin<qint64>(sleep, qint64(timeout) * 1000);
+    }
+    usleep(sleep);
+    return avail() >= PeriodSize;
+}
+
+int NullSink::write(const int16_t *data, int frames)
+{
+    Q_UNUSED(data);
+    if (m_pace == AsFastAsPossible) {
+        return frames;
+    }
+    advance();
+    const int written = qMin<qint64>(frames, BufferSize - m_queued);
+    m_queued += written;
+    return written;
+}
+
+void NullSink::drain()
+{
+    if (m_pace == RealTime && !m_paused) {
+        advance();
+        usleep(m_queued * 1000000 / m_format.sampleRate);
+    }
+    drop();
+}
+
+void NullSink::drop()
+{
+    m_queued = 0;
+    m_remainder = 0;
+    m_paused = false;
+    m_lastUpdate = monotonicMicroseconds();
+}
+
+bool NullSink::pause(bool pause)
+{
+    advance();
+    m_paused = pause;
+    return true;
+}
+
+int NullSink::delay()
+{
+    if (m_pace == AsFastAsPossible) {
+        return 0;
+    }
+    advance();
+    return m_queued;
+}
+
+void NullSink::advance()
+{
+    const qint64 now = monotonicMicroseconds();
+    if (!m_paused) {
+        const qint64 elapsed = (now - m_lastUpdate) * m_format.sampleRate + m_remainder;
+        const qint64 played = elapsed / 1000000;
+        m_remainder = elapsed % 1000000;
+        if (played >= m_queued) {
+            // underrun; do not bank time for audio that was never written
+            if (played > m_queued && m_queued) {
+                recordUnderrun();
+            }
+            m_queued = 0;
+            m_remainder = 0;
+        } else {
+            m_queued -= played;
+        }
+    }
+    m_lastUpdate = now;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NULLSINK_H
+#define NULLSINK_H
+
+#include "audiosink.h"
+
+#include <QtCore/QtGlobal>
+
+/**
+ * Sink that throws audio away, for machines without a sound card. In
+ * RealTime mode it consumes frames at the sample rate from a virtual
+ * device buffer, so the rest of the pipeline behaves as with real
+ * hardware; AsFastAsPossible never makes the writer wait.
+ */
+class NullSink
+    : public AudioSink
+{
+public:
+    enum Pace {
+        RealTime = 0,
+        AsFastAsPossible
+    };
+
+    NullSink(Pace pace);
+    virtual ~NullSink();
+
+    virtual bool open(const Format &format);
+    virtual void close();
+    virtual Format format() const;
+    virtual int periodSize() const;
+    virtual int avail();
+    virtual bool wait(int timeout);
+    virtual int write(const int16_t *data, int frames);
+    virtual void drain();
+    virtual void drop();
+    virtual bool pause(bool pause);
+    virtual int delay();
+
+private:
+    static const int PeriodSize = 1024;
+    static const int BufferSize = PeriodSize * 4;
+
+    /**
+     * Moves the virtual playback position forward to now.
+     */
+    void advance();
+
+    const Pace m_pace;
+    Format     m_format;
+    qint64     m_queued;     // frames in the virtual device buffer
+    qint64     m_lastUpdate; // microseconds, monotonic
+    qint64     m_remainder;  // sub-frame time carried between updates
+    bool       m_paused;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcmblockpool.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+//BEGIN: PcmBlock
+PcmBlock::PcmBlock()
+    : d(0)
+{
+}
+
+PcmBlock::PcmBlock(Storage *storage)
+    : d(storage)
+{
+}
+
+PcmBlock::PcmBlock(const PcmBlock &other)
+    : d(other.d)
+{
+    if (d) {
+        d->ref.ref();
+    }
+}
+
+PcmBlock::~PcmBlock()
+{
+    if (d && !d->ref.deref()) {
+        d->pool->release(d);
+    }
+}
+
+PcmBlock &PcmBlock::operator=(const PcmBlock &other)
+{
+    if (other.d) {
+        other.d->ref.ref();
+    }
+    if (d && !d->ref.deref()) {
+        d->pool->release(d);
+    }
+    d = other.d;
+    return *this;
+}
+
+bool PcmBlock::isNull() const
+{
+    return !d;
+}
+
+int16_t *PcmBlock::data() const
+{
+    return d ? d->data : 0;
+}
+
+int PcmBlock::capacity() const
+{
+    return d ? d->pool->blockSamples() : 0;
+}
+//END: PcmBlock
+
+//BEGIN: PcmBlockPool
+PcmBlockPool::PcmBlockPool(int blockSamples, int preallocatedBlocks)
+    : m_blockSamples(blockSamples)
+    , m_free(0)
+    , m_released(0)
+    , m_all(0)
+    , m_allCapacity(0)
+    , m_locked(false)
+    , m_blocks(0)
+    , m_heapAllocations(0)
+    , m_acquisitions(0)
+    , m_inUse(0)
+{
+    for (int i = 0; i < preallocatedBlocks; ++i) {
+        PcmBlock::Storage *const storage = allocateStorage();
+        storage->next = m_free;
+        m_free = storage;
+    }
+    m_heapAllocations.fetchAndStoreRelaxed(0);
+}
+
+PcmBlockPool::~PcmBlockPool()
+{
+    const int blocks = m_blocks;
+    for (int i = 0; i < blocks; ++i) {
+        delete[] m_all[i]->data;
+        delete m_all[i];
+    }
+    delete[] m_all;
+}
+
+int PcmBlockPool::blockSamples() const
+{
+    return m_blockSamples;
+}
+
+PcmBlock PcmBlockPool::acquire()
+{
+    if (!m_free) {
+        m_free = m_released.fetchAndStoreAcquire(0);
+    }
+
+    PcmBlock::Storage *storage = m_free;
+    if (storage) {
+        m_free = storage->next;
+    } else {
+        storage = allocateStorage();
+    }
+
+    storage->next = 0;
+    storage->ref.fetchAndStoreRelaxed(1);
+    m_acquisitions.ref();
+    m_inUse.ref();
+
+    return PcmBlock(storage);
+}
+
+bool PcmBlockPool::lockMemory()
+{
+    m_locked = true;
+    const int blocks = m_blocks;
+    for (int i = 0; i < blocks; ++i) {
+        if (mlock(m_all[i]->data, m_blockSamples * sizeof(int16_t))) {
+            m_locked = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+PcmBlockPool::Stats PcmBlockPool::stats() const
+{
+    Stats stats;
+    stats.blocks = m_blocks;
+    stats.heapAllocations = m_heapAllocations;
+    stats.acquisitions = m_acquisitions;
+    stats.inUse = m_inUse;
+    return stats;
+}
+
+PcmBlock::Storage *PcmBlockPool::allocateStorage()
+{
+    const int blocks = m_blocks;
+    if (blocks == m_allCapacity) {
+        const int newCapacity = qMax(16, m_allCapacity * 2);
+        PcmBlock::Storage **const all = new PcmBlock::Storage*[newCapacity];
+        if (m_all) {
+            memcpy(all, m_all, blocks * sizeof(PcmBlock::Storage*));
+            delete[] m_all;
+        }
+        m_all = all;
+        m_allCapacity = newCapacity;
+    }
+
+    PcmBlock::Storage *const storage = new PcmBlock::Storage;
+    storage->pool = this;
+    storage->next = 0;
+    storage->data = new int16_t[m_blockSamples];
+    if (m_locked) {
+        mlock(storage->data, m_blockSamples * sizeof(int16_t));
+    }
+    m_all[blocks] = storage;
+
+    m_blocks.ref();
+    m_heapAllocations.ref();
+
+    return storage;
+}
+
+void PcmBlockPool::release(PcmBlock::Storage *storage)
+{
+    // Pushing is safe from any number of threads; popping only ever happens
+    // by taking the whole list at once, so there is no ABA problem.
+    PcmBlock::Storage *head;
+    do {
+        head = m_released;
+        storage->next = head;
+    } while (!m_released.testAndSetRelease(head, storage));
+    m_inUse.deref();
+}
+//END: PcmBlockPool
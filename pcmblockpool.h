@@ -0,0 +1,124 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PCMBLOCKPOOL_H
+#define PCMBLOCKPOOL_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+
+#include <stdint.h>
+
+class PcmBlockPool;
+
+/**
+ * Reference counted handle to a block of interleaved 16 bit samples owned
+ * by a PcmBlockPool. Copying a handle never copies audio, and the block
+ * goes back to its pool when the last handle is dropped. Handles can be
+ * copied and dropped from any thread.
+ */
+class PcmBlock
+{
+public:
+    PcmBlock();
+    PcmBlock(const PcmBlock &other);
+    ~PcmBlock();
+
+    PcmBlock &operator=(const PcmBlock &other);
+
+    bool isNull() const;
+    int16_t *data() const;
+
+    /**
+     * Size of the block in samples.
+     */
+    int capacity() const;
+
+private:
+    friend class PcmBlockPool;
+
+    struct Storage {
+        QAtomicInt    ref;
+        PcmBlockPool *pool;
+        Storage      *next;
+        int16_t      *data;
+    };
+
+    explicit PcmBlock(Storage *storage);
+
+    Storage *d;
+};
+
+/**
+ * Preallocated pool of PcmBlock. Only when every block is in use a new one
+ * is allocated from the heap, and it then stays in the pool for good, so
+ * steady state playback does not allocate at all.
+ *
+ * acquire() is meant to be called from a single thread (the sound feeder),
+ * blocks are given back from whatever thread drops the last handle.
+ */
+class PcmBlockPool
+{
+public:
+    struct Stats {
+        int blocks;          ///< blocks owned by the pool
+        int heapAllocations; ///< blocks allocated after construction
+        int acquisitions;
+        int inUse;
+    };
+
+    PcmBlockPool(int blockSamples, int preallocatedBlocks);
+    ~PcmBlockPool();
+
+    int blockSamples() const;
+
+    PcmBlock acquire();
+
+    /**
+     * Keeps every block, including those allocated later on, in RAM.
+     * To be called from the acquiring thread. Returns false if that was
+     * not permitted.
+     */
+    bool lockMemory();
+
+    Stats stats() const;
+
+private:
+    friend class PcmBlock;
+
+    PcmBlock::Storage *allocateStorage();
+    void release(PcmBlock::Storage *storage);
+
+    const int                          m_blockSamples;
+
+    // Private to the acquiring thread
+    PcmBlock::Storage                 *m_free;
+    // Blocks given back by any thread, grabbed all at once by acquire()
+    QAtomicPointer<PcmBlock::Storage>  m_released;
+    // Every block ever allocated, for cleanup
+    PcmBlock::Storage                **m_all;
+    int                                m_allCapacity;
+    bool                               m_locked;
+
+    mutable QAtomicInt                 m_blocks;
+    mutable QAtomicInt                 m_heapAllocations;
+    mutable QAtomicInt                 m_acquisitions;
+    mutable QAtomicInt                 m_inUse;
+};
+
+#endif
@@ -0,0 +1,437 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pcmringbuffer.h"
+
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+// Positions are free running sample counters; only their difference
+// matters, so wrapping around after 2^32 samples is harmless.
+
+static inline uint32_t loadAcquire(QAtomicInt &atomic)
+{
+    return atomic.fetchAndAddAcquire(0);
+}
+
+static inline void storeRelease(QAtomicInt &atomic, uint32_t value)
+{
+    atomic.fetchAndStoreRelease(value);
+}
+
+PcmRingBuffer::PcmRingBuffer(int capacitySamples)
+    : m_capacity(1)
+    , m_eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_writePos(0)
+    , m_readPos(0)
+    , m_historyStart(0)
+    , m_consumerWaiting(0)
+    , m_writeSampleRate(44100)
+    , m_writeChannels(2)
+    , m_seenDiscards(0)
+    , m_limit(0)
+    , m_readSampleRate(44100)
+    , m_readChannels(2)
+    , m_history(0)
+    , m_markerWritePos(0)
+    , m_markerReadPos(0)
+    , m_discards(0)
+    , m_discardPending(0)
+    , m_discardPos(0)
+    , m_discardMarkerPos(0)
+    , m_highWatermark(0)
+    , m_lowWatermark(0)
+    , m_fullWrites(0)
+{
+    while (m_capacity < capacitySamples) {
+        m_capacity <<= 1;
+    }
+    m_limit = m_capacity;
+    m_lowWatermark.fetchAndStoreRelaxed(m_capacity);
+    m_mask = m_capacity - 1;
+    m_data = new int16_t[m_capacity];
+    memset(m_markers, 0, sizeof(m_markers));
+}
+
+PcmRingBuffer::~PcmRingBuffer()
+{
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+    }
+    delete[] m_data;
+}
+
+int PcmRingBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+bool PcmRingBuffer::lockMemory()
+{
+    return mlock(m_data, m_capacity * sizeof(int16_t)) == 0;
+}
+
+void PcmRingBuffer::setHistory(int samples)
+{
+    m_history = qBound(0, samples, m_capacity);
+}
+
+int PcmRingBuffer::historySamples() const
+{
+    const uint32_t historyStart = loadAcquire(m_historyStart);
+    return int(uint32_t(loadAcquire(m_readPos)) - historyStart);
+}
+
+bool PcmRingBuffer::setFormat(int sampleRate, int channels)
+{
+    // A discard may have thrown away our last FormatChange marker before the
+    // consumer saw it, so announce the format again after every discard.
+    const int discards = m_discards.fetchAndAddAcquire(0);
+    if (sampleRate == m_writeSampleRate && channels == m_writeChannels && discards == m_seenDiscards) {
+        return true;
+    }
+
+    Marker marker;
+    marker.type = FormatChange;
+    marker.sampleRate = sampleRate;
+    marker.channels = channels;
+    if (!queueMarker(marker)) {
+        return false;
+    }
+
+    m_writeSampleRate = sampleRate;
+    m_writeChannels = channels;
+    m_seenDiscards = discards;
+    return true;
+}
+
+int PcmRingBuffer::writeSampleRate() const
+{
+    return m_writeSampleRate;
+}
+
+void PcmRingBuffer::setLimit(int samples)
+{
+    m_limit = qBound(0, samples, m_capacity);
+}
+
+int PcmRingBuffer::limit() const
+{
+    return m_limit;
+}
+
+int PcmRingBuffer::writeAvailable() const
+{
+    return writeRoom(m_writePos.fetchAndAddRelaxed(0)) / m_writeChannels;
+}
+
+int PcmRingBuffer::framesQueued() const
+{
+    return samplesQueued() / m_writeChannels;
+}
+
+int PcmRingBuffer::write(const int16_t *frames, int numFrames)
+{
+    const uint32_t writePos = m_writePos.fetchAndAddRelaxed(0);
+    const int toWrite = qMin(numFrames, writeRoom(writePos) / m_writeChannels) * m_writeChannels;
+    if (toWrite < numFrames * m_writeChannels) {
+        m_fullWrites.ref();
+    }
+    if (toWrite <= 0) {
+        return 0;
+    }
+
+    const int offset = writePos & m_mask;
+    const int firstPart = qMin(toWrite, m_capacity - offset);
+    memcpy(m_data + offset, frames, firstPart * sizeof(int16_t));
+    if (firstPart < toWrite) {
+        memcpy(m_data, frames + firstPart, (toWrite - firstPart) * sizeof(int16_t));
+    }
+
+    m_writePos.fetchAndStoreOrdered(writePos + toWrite);
+    signalConsumer();
+
+    const int queued = samplesQueued();
+    if (queued > m_highWatermark) {
+        m_highWatermark.fetchAndStoreRelaxed(queued);
+    }
+
+    return toWrite / m_writeChannels;
+}
+
+bool PcmRingBuffer::writeMarker(MarkerType type)
+{
+    Marker marker;
+    marker.type = type;
+    marker.sampleRate = m_writeSampleRate;
+    marker.channels = m_writeChannels;
+    return queueMarker(marker);
+}
+
+int PcmRingBuffer::sampleRate() const
+{
+    return m_readSampleRate;
+}
+
+int PcmRingBuffer::channels() const
+{
+    return m_readChannels;
+}
+
+int PcmRingBuffer::readAvailable()
+{
+    applyDiscard();
+    return samplesUntilMarker(m_readPos.fetchAndAddRelaxed(0)) / m_readChannels;
+}
+
+int PcmRingBuffer::read(int16_t *frames, int maxFrames)
+{
+    applyDiscard();
+
+    const uint32_t readPos = m_readPos.fetchAndAddRelaxed(0);
+    const int toRead = qMin(maxFrames, samplesUntilMarker(readPos) / m_readChannels) * m_readChannels;
+    if (toRead <= 0) {
+        return 0;
+    }
+
+    const int offset = readPos & m_mask;
+    const int firstPart = qMin(toRead, m_capacity - offset);
+    memcpy(frames, m_data + offset, firstPart * sizeof(int16_t));
+    if (firstPart < toRead) {
+        memcpy(frames + firstPart, m_data, (toRead - firstPart) * sizeof(int16_t));
+    }
+
+    storeRelease(m_readPos, readPos + toRead);
+    if (int(readPos + toRead - loadAcquire(m_historyStart)) > m_history) {
+        storeRelease(m_historyStart, readPos + toRead - m_history);
+    }
+
+    const int queued = samplesQueued();
+    if (queued < m_lowWatermark) {
+        m_lowWatermark.fetchAndStoreRelaxed(queued);
+    }
+
+    return toRead / m_readChannels;
+}
+
+bool PcmRingBuffer::takeMarker(Marker *marker)
+{
+    applyDiscard();
+
+    const uint32_t markerReadPos = m_markerReadPos.fetchAndAddRelaxed(0);
+    if (markerReadPos == loadAcquire(m_markerWritePos)) {
+        return false;
+    }
+
+    // A marker queued while discard() ran can be left behind the read
+    // position; it is due all the same
+    const QueuedMarker &queued = m_markers[markerReadPos % MarkerCapacity];
+    const uint32_t readPos = m_readPos.fetchAndAddRelaxed(0);
+    if (int(queued.position - readPos) > 0) {
+        return false;
+    }
+
+    *marker = queued.marker;
+    storeRelease(m_historyStart, readPos);
+    if (marker->type == FormatChange) {
+        m_readSampleRate = marker->sampleRate;
+        m_readChannels = marker->channels;
+    }
+    storeRelease(m_markerReadPos, markerReadPos + 1);
+
+    return true;
+}
+
+int PcmRingBuffer::rewind(int frames)
+{
+    applyDiscard();
+
+    const uint32_t readPos = m_readPos.fetchAndAddRelaxed(0);
+    const int history = int(readPos - loadAcquire(m_historyStart)) / m_readChannels;
+    const int toRewind = qBound(0, frames, history) * m_readChannels;
+    storeRelease(m_readPos, readPos - toRewind);
+
+    return toRewind / m_readChannels;
+}
+
+int PcmRingBuffer::framesAfterEndOfTrack()
+{
+    applyDiscard();
+
+    const uint32_t markerReadPos = m_markerReadPos.fetchAndAddRelaxed(0);
+    const uint32_t markerWritePos = loadAcquire(m_markerWritePos);
+    if (markerReadPos == markerWritePos || m_markers[markerReadPos % MarkerCapacity].marker.type != EndOfTrack) {
+        return -1;
+    }
+
+    const uint32_t position = m_markers[markerReadPos % MarkerCapacity].position;
+    uint32_t end = loadAcquire(m_writePos);
+    if (markerReadPos + 1 != markerWritePos) {
+        end = m_markers[(markerReadPos + 1) % MarkerCapacity].position;
+    }
+    return int(end - position) / m_readChannels;
+}
+
+bool PcmRingBuffer::waitForData(int timeout)
+{
+    if (hasPendingData()) {
+        return true;
+    }
+
+    // Announce that we are going to sleep before checking again, so that a
+    // producer writing in between is guaranteed to see the flag and signal us.
+    m_consumerWaiting.fetchAndStoreOrdered(1);
+    if (!hasPendingData()) {
+        pollfd pfd;
+        pfd.fd = m_eventFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        while (poll(&pfd, 1, timeout) == -1 && errno == EINTR) {
+        }
+        uint64_t value;
+        while (::read(m_eventFd, &value, sizeof(value)) == -1 && errno == EINTR) {
+        }
+    }
+    m_consumerWaiting.fetchAndStoreOrdered(0);
+
+    return hasPendingData();
+}
+
+int PcmRingBuffer::samplesQueued() const
+{
+    const uint32_t writePos = loadAcquire(m_writePos);
+    const uint32_t readPos = loadAcquire(m_readPos);
+    return int(writePos - readPos);
+}
+
+void PcmRingBuffer::discard()
+{
+    // Markers first: those queued before markerWritePos sit at or before
+    // the writePos loaded after it, so none is dropped while the audio
+    // after it is kept. A marker queued in between is kept, and ends up at
+    // or behind the discard point, where takeMarker() hands it out next.
+    discardFrom(loadAcquire(m_markerWritePos));
+}
+
+void PcmRingBuffer::discardFrom(uint32_t markerWritePos)
+{
+    const uint32_t writePos = loadAcquire(m_writePos);
+    m_discardMarkerPos.fetchAndStoreOrdered(markerWritePos);
+    m_discardPos.fetchAndStoreOrdered(writePos);
+    m_discardPending.fetchAndStoreOrdered(1);
+    m_discards.ref();
+}
+
+void PcmRingBuffer::wakeUp()
+{
+    const uint64_t one = 1;
+    while (::write(m_eventFd, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+}
+
+PcmRingBuffer::Stats PcmRingBuffer::stats() const
+{
+    Stats stats;
+    stats.highWatermark = m_highWatermark;
+    stats.lowWatermark = qMin(int(m_lowWatermark), int(m_highWatermark));
+    stats.fullWrites = m_fullWrites;
+    return stats;
+}
+
+void PcmRingBuffer::resetStats()
+{
+    m_highWatermark.fetchAndStoreRelaxed(0);
+    m_lowWatermark.fetchAndStoreRelaxed(m_capacity);
+    m_fullWrites.fetchAndStoreRelaxed(0);
+}
+
+bool PcmRingBuffer::queueMarker(const Marker &marker)
+{
+    const uint32_t markerWritePos = m_markerWritePos.fetchAndAddRelaxed(0);
+    if (int(markerWritePos - loadAcquire(m_markerReadPos)) >= MarkerCapacity) {
+        return false;
+    }
+
+    QueuedMarker &queued = m_markers[markerWritePos % MarkerCapacity];
+    queued.position = m_writePos.fetchAndAddRelaxed(0);
+    queued.marker = marker;
+
+    m_markerWritePos.fetchAndStoreOrdered(markerWritePos + 1);
+    signalConsumer();
+
+    return true;
+}
+
+bool PcmRingBuffer::hasPendingData()
+{
+    return readAvailable() || uint32_t(m_markerReadPos.fetchAndAddRelaxed(0)) != loadAcquire(m_markerWritePos);
+}
+
+void PcmRingBuffer::applyDiscard()
+{
+    if (!m_discardPending.fetchAndStoreAcquire(0)) {
+        return;
+    }
+
+    const uint32_t discardPos = m_discardPos.fetchAndAddRelaxed(0);
+    const uint32_t readPos = m_readPos.fetchAndAddRelaxed(0);
+    if (int(discardPos - readPos) > 0) {
+        storeRelease(m_readPos, discardPos);
+    }
+
+    const uint32_t discardMarkerPos = m_discardMarkerPos.fetchAndAddRelaxed(0);
+    const uint32_t markerReadPos = m_markerReadPos.fetchAndAddRelaxed(0);
+    if (int(discardMarkerPos - markerReadPos) > 0) {
+        storeRelease(m_markerReadPos, discardMarkerPos);
+    }
+
+    // What was played before a discard is not worth going back to
+    storeRelease(m_historyStart, m_readPos.fetchAndAddRelaxed(0));
+}
+
+int PcmRingBuffer::samplesUntilMarker(uint32_t readPos)
+{
+    const uint32_t writePos = loadAcquire(m_writePos);
+    int available = int(writePos - readPos);
+
+    const uint32_t markerReadPos = m_markerReadPos.fetchAndAddRelaxed(0);
+    if (markerReadPos != loadAcquire(m_markerWritePos)) {
+        const QueuedMarker &queued = m_markers[markerReadPos % MarkerCapacity];
+        available = qMin(available, int(queued.position - readPos));
+    }
+
+    return qMax(available, 0);
+}
+
+int PcmRingBuffer::writeRoom(uint32_t writePos) const
+{
+    const uint32_t readPos = loadAcquire(m_readPos);
+    const uint32_t historyStart = loadAcquire(m_historyStart);
+    return qMax(qMin(m_limit - int(writePos - readPos), m_capacity - int(writePos - historyStart)), 0);
+}
+
+void PcmRingBuffer::signalConsumer()
+{
+    if (m_consumerWaiting.fetchAndAddOrdered(0)) {
+        wakeUp();
+    }
+}
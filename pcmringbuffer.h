@@ -0,0 +1,208 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PCMRINGBUFFER_H
+#define PCMRINGBUFFER_H
+
+#include <QtCore/QAtomicInt>
+
+#include <stdint.h>
+
+/**
+ * Fixed capacity, single producer/single consumer ring of interleaved
+ * 16 bit frames. The producer is the libspotify delivery thread, the
+ * consumer is the sound feeder. Neither side ever takes a lock; the
+ * consumer only sleeps (on an eventfd) when the ring is empty.
+ *
+ * Markers can be inserted in-band by the producer, and the consumer
+ * will never read past a marker before taking it. Format changes travel
+ * as markers too: the producer announces its format with setFormat(), and
+ * the consumer side format follows when it takes the FormatChange marker.
+ *
+ * discard() can be called from any thread. It is applied lazily by the
+ * consumer, and only throws away what had been written when it was called.
+ *
+ * The consumer can keep some history: samples it has already read stay in
+ * the ring, and rewind() reads them again. History never reaches back
+ * past a marker or a discard, so it always belongs to the track being read.
+ */
+class PcmRingBuffer
+{
+public:
+    enum MarkerType {
+        EndOfTrack = 0,
+        FormatChange
+    };
+
+    struct Marker {
+        MarkerType type;
+        int        sampleRate;
+        int        channels;
+    };
+
+    struct Stats {
+        int highWatermark; ///< most samples queued after a write
+        int lowWatermark;  ///< fewest samples left queued after a read
+        int fullWrites;    ///< writes cut short because the ring was full
+    };
+
+    /**
+     * @param capacitySamples is rounded up to the next power of two.
+     */
+    PcmRingBuffer(int capacitySamples);
+    ~PcmRingBuffer();
+
+    int capacity() const;
+
+    /**
+     * Keeps the samples in RAM, so that the consumer never waits for them
+     * to be paged in. Returns false if that was not permitted.
+     */
+    bool lockMemory();
+
+    /**
+     * Samples of history to keep behind the read position. Producer room
+     * comes out of the capacity, so to be set before use.
+     */
+    void setHistory(int samples);
+
+    /**
+     * Samples of history there are to rewind to. Can be called from any
+     * thread.
+     */
+    int historySamples() const;
+
+    //BEGIN: producer side
+    /**
+     * Inserts a FormatChange marker if the format differs from the last one
+     * announced, or if it might have been discarded since.
+     * @return false if the marker could not be queued yet.
+     */
+    bool setFormat(int sampleRate, int channels);
+    int writeSampleRate() const;
+
+    /**
+     * Caps how many samples may be queued, below the capacity.
+     */
+    void setLimit(int samples);
+    int limit() const;
+    int writeAvailable() const;
+
+    /**
+     * Frames waiting to be read, counted in the producer format.
+     */
+    int framesQueued() const;
+    int write(const int16_t *frames, int numFrames);
+    bool writeMarker(MarkerType type);
+    //END: producer side
+
+    //BEGIN: consumer side
+    int sampleRate() const;
+    int channels() const;
+    int readAvailable();
+    int read(int16_t *frames, int maxFrames);
+    bool takeMarker(Marker *marker);
+
+    /**
+     * Steps back over up to @p frames already read, so they are read again.
+     * @return the number of frames rewound.
+     */
+    int rewind(int frames);
+
+    /**
+     * If the next marker is an EndOfTrack, the frames queued after it and
+     * before any other marker, in the current format. -1 otherwise.
+     */
+    int framesAfterEndOfTrack();
+
+    /**
+     * Blocks until there is something to read or take, wakeUp() is called
+     * or @p timeout milliseconds have passed (-1 waits forever).
+     * @return whether there is something to read or take.
+     */
+    bool waitForData(int timeout = -1);
+    //END: consumer side
+
+    int samplesQueued() const;
+    void discard();
+    void wakeUp();
+
+    /**
+     * Can be called from any thread.
+     */
+    Stats stats() const;
+    void resetStats();
+
+private:
+    // Runs the producer between the two halves of discard(), in audiobench
+    friend class MarkerRace;
+
+    struct QueuedMarker {
+        uint32_t position;
+        Marker   marker;
+    };
+
+    static const int MarkerCapacity = 16;
+
+    bool queueMarker(const Marker &marker);
+    bool hasPendingData();
+    void discardFrom(uint32_t markerWritePos);
+    void applyDiscard();
+    int samplesUntilMarker(uint32_t readPos);
+    void signalConsumer();
+    int writeRoom(uint32_t writePos) const;
+
+    int16_t            *m_data;
+    int                 m_capacity;
+    int                 m_mask;
+    int                 m_eventFd;
+
+    // Positions count samples, not frames
+    mutable QAtomicInt  m_writePos;
+    mutable QAtomicInt  m_readPos;
+    // Oldest sample kept; only moves forward, so that the producer never
+    // overwrites what the consumer may still rewind to
+    mutable QAtomicInt  m_historyStart;
+    mutable QAtomicInt  m_consumerWaiting;
+
+    // Owned by the producer
+    int                 m_writeSampleRate;
+    int                 m_writeChannels;
+    int                 m_seenDiscards;
+    int                 m_limit;
+
+    // Owned by the consumer
+    int                 m_readSampleRate;
+    int                 m_readChannels;
+    int                 m_history;
+
+    QueuedMarker        m_markers[MarkerCapacity];
+    mutable QAtomicInt  m_markerWritePos;
+    mutable QAtomicInt  m_markerReadPos;
+
+    QAtomicInt          m_discards;
+    QAtomicInt          m_discardPending;
+    QAtomicInt          m_discardPos;
+    QAtomicInt          m_discardMarkerPos;
+
+    mutable QAtomicInt  m_highWatermark;
+    mutable QAtomicInt  m_lowWatermark;
+    mutable QAtomicInt  m_fullWrites;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "playbackclock.h"
+
+#include <time.h>
+
+PlaybackClock::PlaybackClock()
+    : m_sequence(0)
+    , m_writtenBase(0)
+    , m_writtenFrames(0)
+    , m_sampleRate(44100)
+{
+    m_snapshot.audible = 0;
+    m_snapshot.written = 0;
+    m_snapshot.timestamp = now();
+    m_snapshot.paused = false;
+    m_snapshot.sourceRate = 44100;
+    m_snapshot.sourceChannels = 2;
+}
+
+qint64 PlaybackClock::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void PlaybackClock::reset(qint64 position)
+{
+    m_writtenBase = position;
+    m_writtenFrames = 0;
+
+    m_sequence.fetchAndAddOrdered(1);
+    m_snapshot.audible = position;
+    m_snapshot.written = position;
+    m_snapshot.timestamp = now();
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+void PlaybackClock::startTrack(int delayFrames, int sampleRate)
+{
+    m_writtenBase = 0;
+    m_writtenFrames = 0;
+    m_sampleRate = sampleRate;
+
+    m_sequence.fetchAndAddOrdered(1);
+    m_snapshot.audible = -qint64(delayFrames) * 1000000 / sampleRate;
+    m_snapshot.written = 0;
+    m_snapshot.timestamp = now();
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+void PlaybackClock::framesWritten(int frames, int sampleRate, int delayFrames)
+{
+    // Keep counting frames rather than microseconds so rounding does not
+    // add up over a track; fold them in when the rate changes.
+    if (sampleRate != m_sampleRate) {
+        m_writtenBase += m_writtenFrames * 1000000 / m_sampleRate;
+        m_writtenFrames = 0;
+        m_sampleRate = sampleRate;
+    }
+    m_writtenFrames += frames;
+
+    const qint64 timestamp = now();
+    const qint64 written = m_writtenBase + m_writtenFrames * 1000000 / m_sampleRate;
+    qint64 audible = written - qint64(delayFrames) * 1000000 / m_sampleRate;
+
+    // The delay the sink reports jitters by a few frames; do not let the
+    // position step back from what readers may already have seen.
+    const Snapshot previous = m_snapshot;
+    audible = qMax(audible, qMin(previous.audible + timestamp - previous.timestamp, previous.written));
+
+    m_sequence.fetchAndAddOrdered(1);
+    m_snapshot.audible = audible;
+    m_snapshot.written = written;
+    m_snapshot.timestamp = timestamp;
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+void PlaybackClock::pause(bool paused)
+{
+    const Snapshot previous = m_snapshot;
+    if (paused == previous.paused) {
+        return;
+    }
+
+    const qint64 timestamp = now();
+    m_sequence.fetchAndAddOrdered(1);
+    if (paused) {
+        m_snapshot.audible = qMin(previous.audible + timestamp - previous.timestamp, previous.written);
+    }
+    m_snapshot.timestamp = timestamp;
+    m_snapshot.paused = paused;
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+void PlaybackClock::setSourceFormat(int sampleRate, int channels)
+{
+    m_sequence.fetchAndAddOrdered(1);
+    m_snapshot.sourceRate = sampleRate;
+    m_snapshot.sourceChannels = channels;
+    m_sequence.fetchAndAddOrdered(1);
+}
+
+qint64 PlaybackClock::position() const
+{
+    const Snapshot current = snapshot();
+    if (current.paused) {
+        return current.audible;
+    }
+    return qMin(current.audible + now() - current.timestamp, current.written);
+}
+
+qint64 PlaybackClock::writtenPosition() const
+{
+    return snapshot().written;
+}
+
+PlaybackClock::Written PlaybackClock::written() const
+{
+    const Snapshot current = snapshot();
+    Written result;
+    result.position = current.written;
+    result.sampleRate = current.sourceRate;
+    result.channels = current.sourceChannels;
+    return result;
+}
+
+PlaybackClock::Snapshot PlaybackClock::snapshot() const
+{
+    Snapshot result;
+    int sequence;
+    do {
+        sequence = m_sequence.fetchAndAddAcquire(0);
+        result = m_snapshot;
+    } while ((sequence & 1) || m_sequence.fetchAndAddOrdered(0) != sequence);
+    return result;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QtCore/QtGlobal>
+#include <QtCore/QAtomicInt>
+
+/**
+ * Position of what is audible right now in the current track, in
+ * microseconds.
+ *
+ * The sound feeder updates it after every write with the frames it wrote
+ * and the sink delay at that moment. Between updates the position is
+ * interpolated with the monotonic clock, but it never gets ahead of what
+ * has been written, so it stops by itself when the sink runs dry.
+ *
+ * Updates must be serialized by the caller (they all happen on the sound
+ * feeder thread). position() is lock free and can be called from any
+ * thread.
+ */
+class PlaybackClock
+{
+public:
+    PlaybackClock();
+
+    /**
+     * Microseconds on the monotonic clock.
+     */
+    static qint64 now();
+
+    //BEGIN: writer side
+    /**
+     * Restarts the clock at @p position, for the next frame to be written.
+     */
+    void reset(qint64 position);
+
+    /**
+     * Restarts the clock at the boundary between two tracks, when the end
+     * of the previous one (@p delayFrames at @p sampleRate) is still to be
+     * played. position() is negative until it has been.
+     */
+    void startTrack(int delayFrames, int sampleRate);
+
+    /**
+     * Records @p frames more written to the sink, which reported
+     * @p delayFrames still to be played after the write.
+     */
+    void framesWritten(int frames, int sampleRate, int delayFrames);
+
+    /**
+     * Stops the position where it is while the sink is paused, and lets
+     * it go on from there.
+     */
+    void pause(bool paused);
+
+    /**
+     * Records the format of the audio now being read from the ring, for
+     * readers that turn positions into samples.
+     */
+    void setSourceFormat(int sampleRate, int channels);
+    //END: writer side
+
+    /**
+     * Interpolated audible position, in microseconds. Never goes backwards
+     * between resets, and is negative right after startTrack().
+     */
+    qint64 position() const;
+
+    /**
+     * Position right after the last frame written to the sink.
+     */
+    qint64 writtenPosition() const;
+
+    struct Written {
+        qint64 position;    ///< right after the last frame written to the sink
+        int    sampleRate;  ///< of the ring at that point
+        int    channels;
+    };
+
+    /**
+     * writtenPosition() along with the ring format it was read in, from the
+     * same update.
+     */
+    Written written() const;
+
+private:
+    struct Snapshot {
+        qint64 audible;   ///< audible position at timestamp
+        qint64 written;   ///< position right after the last written frame
+        qint64 timestamp;
+        bool   paused;
+        int    sourceRate;
+        int    sourceChannels;
+    };
+
+    Snapshot snapshot() const;
+
+    // Seqlock: odd while the writer is updating m_snapshot
+    mutable QAtomicInt m_sequence;
+    Snapshot           m_snapshot;
+
+    // Owned by the writer
+    qint64             m_writtenBase;
+    qint64             m_writtenFrames;
+    int                m_sampleRate;
+};
+
+#endif
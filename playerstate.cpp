@@ -0,0 +1,119 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "playerstate.h"
+
+#include <KDebug>
+
+#define STATE_BIT(state) (1 << PlayerState::state)
+
+// States each state can go to. Anything can stop, and a new track can be
+// loaded from anywhere but while one is loading
+static const int s_transitions[] = {
+    /* Stopped   */ STATE_BIT(Loading),
+    /* Loading   */ STATE_BIT(Stopped) | STATE_BIT(Buffering) | STATE_BIT(Paused),
+    /* Buffering */ STATE_BIT(Stopped) | STATE_BIT(Loading) | STATE_BIT(Playing) | STATE_BIT(Paused) | STATE_BIT(Seeking),
+    /* Playing   */ STATE_BIT(Stopped) | STATE_BIT(Loading) | STATE_BIT(Paused) | STATE_BIT(Seeking) | STATE_BIT(Ended),
+    /* Paused    */ STATE_BIT(Stopped) | STATE_BIT(Loading) | STATE_BIT(Playing),
+    /* Seeking   */ STATE_BIT(Stopped) | STATE_BIT(Loading) | STATE_BIT(Playing) | STATE_BIT(Paused),
+    /* Ended     */ STATE_BIT(Stopped) | STATE_BIT(Loading)
+};
+
+#undef STATE_BIT
+
+PlayerState::PlayerState(QObject *parent)
+    : QObject(parent)
+    , m_state(Stopped)
+    , m_exiting(0)
+{
+    qRegisterMetaType<PlayerState::State>("PlayerState::State");
+}
+
+PlayerState::~PlayerState()
+{
+}
+
+PlayerState::State PlayerState::state() const
+{
+    return static_cast<State>(m_state.fetchAndAddAcquire(0));
+}
+
+bool PlayerState::isActive() const
+{
+    const State current = state();
+    return current == Loading || current == Buffering || current == Playing || current == Seeking;
+}
+
+bool PlayerState::setState(State state)
+{
+    Q_FOREVER {
+        const State current = this->state();
+        if (current == state) {
+            return true;
+        }
+        if (!isValidTransition(current, state)) {
+            kWarning() << "Refusing player state transition from" << name(current) << "to" << name(state);
+            return false;
+        }
+        if (m_state.testAndSetOrdered(current, state)) {
+            emit stateChanged(state);
+            return true;
+        }
+    }
+}
+
+bool PlayerState::transition(State from, State to)
+{
+    if (!isValidTransition(from, to) || !m_state.testAndSetOrdered(from, to)) {
+        return false;
+    }
+    emit stateChanged(to);
+    return true;
+}
+
+void PlayerState::audioStarted()
+{
+    const State current = state();
+    if (current == Buffering || current == Seeking) {
+        transition(current, Playing);
+    }
+}
+
+void PlayerState::setExiting()
+{
+    m_exiting.fetchAndStoreRelease(1);
+}
+
+bool PlayerState::isExiting() const
+{
+    return m_exiting.fetchAndAddAcquire(0);
+}
+
+bool PlayerState::isValidTransition(State from, State to)
+{
+    return s_transitions[from] & (1 << to);
+}
+
+const char *PlayerState::name(State state)
+{
+    static const char *const names[] = {
+        "Stopped", "Loading", "Buffering", "Playing", "Paused", "Seeking", "Ended"
+    };
+    return names[state];
+}
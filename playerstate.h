@@ -0,0 +1,107 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PLAYERSTATE_H
+#define PLAYERSTATE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMetaType>
+
+/**
+ * What the player is doing, as a state machine.
+ *
+ * The main thread drives it as the user plays, pauses and seeks; the sound
+ * feeder only moves it to Playing when the first audio after a load or a
+ * seek reaches the sink. Widgets follow stateChanged() and never hold state
+ * of their own.
+ *
+ * Transitions are validated: setState() refuses those that make no sense,
+ * such as pausing while stopped, and says so on the debug output. state()
+ * and isExiting() are lock free and can be called from any thread.
+ */
+class PlayerState
+    : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Stopped = 0,
+        Loading,    ///< a track is being loaded by libspotify
+        Buffering,  ///< loaded, waiting for its first audio to be heard
+        Playing,
+        Paused,
+        Seeking,    ///< waiting for audio from the new position
+        Ended       ///< the last track of the queue played out
+    };
+
+    PlayerState(QObject *parent = 0);
+    virtual ~PlayerState();
+
+    State state() const;
+
+    /**
+     * Whether a track is loading or playing, that is, whether it would be
+     * heard if nobody touched anything.
+     */
+    bool isActive() const;
+
+    /**
+     * Moves to @p state, if it can be reached from the current one. Moving
+     * to the current state succeeds and changes nothing.
+     */
+    bool setState(State state);
+
+    /**
+     * Moves from @p from to @p to, only if the player is still in @p from.
+     */
+    bool transition(State from, State to);
+
+    /**
+     * Called by the sound feeder whenever it writes: the first write after
+     * a load or a seek moves to Playing.
+     */
+    void audioStarted();
+
+    /**
+     * Set once, when the application quits; threads waiting for audio give
+     * up when they see it.
+     */
+    void setExiting();
+    bool isExiting() const;
+
+    static bool isValidTransition(State from, State to);
+    static const char *name(State state);
+
+Q_SIGNALS:
+    /**
+     * Emitted from the thread that made the change; connections to widgets
+     * are queued when that is not the main thread.
+     */
+    void stateChanged(PlayerState::State state);
+
+private:
+    mutable QAtomicInt m_state;
+    mutable QAtomicInt m_exiting;
+};
+
+Q_DECLARE_METATYPE(PlayerState::State)
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "realfft.h"
+#include "audiokernels.h"
+
+#include <math.h>
+
+RealFFT::RealFFT(int exp2)
+    : m_size(1 << exp2)
+    , m_half(m_size / 2)
+    , m_reversed(new int[m_half])
+    , m_stageRe(new float[m_half])
+    , m_stageIm(new float[m_half])
+    , m_splitRe(new float[m_half])
+    , m_splitIm(new float[m_half])
+    , m_re(new float[m_half])
+    , m_im(new float[m_half])
+{
+    const int bits = exp2 - 1;
+    for (int i = 0; i < m_half; ++i) {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        m_reversed[i] = reversed;
+    }
+
+    for (int h = 4; h < m_half; h *= 2) {
+        for (int j = 0; j < h; ++j) {
+            m_stageRe[h + j] = cos(M_PI * j / h);
+            m_stageIm[h + j] = -sin(M_PI * j / h);
+        }
+    }
+
+    for (int k = 0; k < m_half; ++k) {
+        m_splitRe[k] = cos(2 * M_PI * k / m_size);
+        m_splitIm[k] = -sin(2 * M_PI * k / m_size);
+    }
+}
+
+RealFFT::~RealFFT()
+{
+    delete[] m_reversed;
+    delete[] m_stageRe;
+    delete[] m_stageIm;
+    delete[] m_splitRe;
+    delete[] m_splitIm;
+    delete[] m_re;
+    delete[] m_im;
+}
+
+int RealFFT::size() const
+{
+    return m_size;
+}
+
+void RealFFT::transform(float *data)
+{
+    float *const re = m_re;
+    float *const im = m_im;
+
+    // Even values are the real parts, odd ones the imaginary parts
+    for (int i = 0; i < m_half; ++i) {
+        re[m_reversed[i]] = data[2 * i];
+        im[m_reversed[i]] = data[2 * i + 1];
+    }
+
+    // The first two radix-2 stages as one radix-4 pass; their twiddles are
+    // 1 and -i
+    for (int i = 0; i < m_half; i += 4) {
+        const float sr0 = re[i] + re[i + 1];
+        const float si0 = im[i] + im[i + 1];
+        const float dr0 = re[i] - re[i + 1];
+        const float di0 = im[i] - im[i + 1];
+        const float sr1 = re[i + 2] + re[i + 3];
+        const float si1 = im[i + 2] + im[i + 3];
+        const float dr1 = re[i + 2] - re[i + 3];
+        const float di1 = im[i + 2] - im[i + 3];
+        re[i] = sr0 + sr1;
+        im[i] = si0 + si1;
+        re[i + 2] = sr0 - sr1;
+        im[i + 2] = si0 - si1;
+        re[i + 1] = dr0 + di1;
+        im[i + 1] = di0 - dr1;
+        re[i + 3] = dr0 - di1;
+        im[i + 3] = di0 + dr1;
+    }
+
+    for (int h = 4; h < m_half; h *= 2) {
+        AudioKernels::fftStage(re, im, m_stageRe + h, m_stageIm + h, m_half, h);
+    }
+
+    // Bins k and half - k of the complex FFT hold the even and odd parts of
+    // bin k of the real one
+    data[0] = re[0] + im[0];
+    data[1] = re[0] - im[0];
+    for (int k = 1; k < m_half; ++k) {
+        const int j = m_half - k;
+        const float evenRe = (re[k] + re[j]) * 0.5f;
+        const float evenIm = (im[k] - im[j]) * 0.5f;
+        const float oddRe = (im[k] + im[j]) * 0.5f;
+        const float oddIm = (re[j] - re[k]) * 0.5f;
+        data[2 * k] = evenRe + m_splitRe[k] * oddRe - m_splitIm[k] * oddIm;
+        data[2 * k + 1] = evenIm + m_splitRe[k] * oddIm + m_splitIm[k] * oddRe;
+    }
+}
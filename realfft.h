@@ -0,0 +1,67 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef REALFFT_H
+#define REALFFT_H
+
+/**
+ * Fourier transform of 2^n real values.
+ *
+ * The real input is transformed as a complex FFT of half the size and split
+ * back into the real spectrum afterwards. The complex FFT is iterative and
+ * in place: the input goes through the bit reversal table, then a radix-4
+ * pass (which needs no twiddles) and radix-2 stages, each of which has its
+ * own contiguous twiddle table so it runs on AudioKernels::fftStage(), in
+ * SIMD where the CPU allows. Every table is computed in the constructor;
+ * transform() does not allocate.
+ */
+class RealFFT
+{
+public:
+    /**
+     * Transform of 2^@p exp2 values, @p exp2 being at least 3.
+     */
+    explicit RealFFT(int exp2);
+    ~RealFFT();
+
+    int size() const;
+
+    /**
+     * Transforms the size() values of @p data in place. The result is
+     * packed: the real parts of bins 0 and size() / 2 (both of which have
+     * no imaginary part), then the real and imaginary parts of bins 1 to
+     * size() / 2 - 1.
+     */
+    void transform(float *data);
+
+private:
+    int    m_size;
+    int    m_half;  // size of the complex FFT
+    int   *m_reversed;
+    // Twiddles of the radix-2 stage with blocks of 2 * h values start at h
+    float *m_stageRe;
+    float *m_stageIm;
+    // Twiddles splitting the complex FFT into the real spectrum
+    float *m_splitRe;
+    float *m_splitIm;
+    float *m_re;
+    float *m_im;
+};
+
+#endif
@@ -18,49 +18,674 @@
 
 #include "soundfeeder.h"
 #include "mainwindow.h"
-#include <QDebug>
+#include "audiosink.h"
+#include "chunk.h"
+#include <KDebug>
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 SoundFeeder::SoundFeeder(QObject *parent)
     : QThread(parent)
+    , m_realTime(false)
+    , m_roundRobin(false)
+    , m_realTimePriority(0)
+    , m_cpu(-1)
+    , m_converter(BlockSamples)
+    , m_crossfader(CrossfadeSamples)
+    , m_paused(false)
+    , m_sinkPaused(false)
+    , m_effectStart(0)
+    , m_effectType(FeederCommandQueue::Stop)
+    , m_seekArmed(false)
+    , m_normalizer(AudioGraph::BlockFrames * AudioGraph::MaxChannels)
+    , m_trackLoudness(0)
+    , m_trackLoudnessPending(0)
+    , m_nextTrackLoudness(LoudnessNormalizer::UnknownLoudness * 100)
+    , m_ringWaits(0)
+    , m_deviceWaits(0)
+    , m_writes(0)
+    , m_minWriteFrames(0)
+    , m_maxWriteFrames(0)
+    , m_sinkDelay(0)
+    , m_crossfades(0)
+    , m_historySeeks(0)
+    , m_streamSeeks(0)
+    , m_skips(0)
+    , m_pauses(0)
+    , m_resumes(0)
+    , m_closeCalls(0)
+    , m_bufferChanges(0)
+    , m_scheduling(NormalScheduling)
+    , m_memoryLocked(0)
+    , m_totalsSequence(0)
+    , m_framesWritten(0)
+    , m_copiedFrames(0)
+    , m_directFrames(0)
+    , m_historySeekMicroseconds(0)
+    , m_streamSeekMicroseconds(0)
+    , m_skipMicroseconds(0)
+    , m_pauseMicroseconds(0)
+    , m_resumeMicroseconds(0)
 {
+    // Each track gets its own gain before the tail of the previous one is
+    // mixed in, and the mix is equalized as a whole
+    m_graph.addNode(&m_normalizer);
+    m_graph.addNode(&m_crossfader);
+    m_graph.addNode(&m_equalizer);
 }
 
 SoundFeeder::~SoundFeeder()
 {
 }
 
+SoundFeeder::Stats SoundFeeder::stats() const
+{
+    Stats stats;
+    stats.ringWaits = m_ringWaits;
+    stats.deviceWaits = m_deviceWaits;
+    stats.writes = m_writes;
+    stats.minWriteFrames = m_minWriteFrames;
+    stats.maxWriteFrames = m_maxWriteFrames;
+    stats.crossfades = m_crossfades;
+    stats.equalizerBands = m_equalizer.activeBands();
+    stats.historySeeks = m_historySeeks;
+    stats.streamSeeks = m_streamSeeks;
+    stats.skips = m_skips;
+    stats.pauses = m_pauses;
+    stats.resumes = m_resumes;
+    stats.closeCalls = m_closeCalls;
+    stats.bufferChanges = m_bufferChanges;
+    stats.scheduling = Scheduling(int(m_scheduling));
+    stats.memoryLocked = m_memoryLocked;
+    int sequence;
+    do {
+        sequence = m_totalsSequence.fetchAndAddAcquire(0);
+        stats.framesWritten = m_framesWritten;
+        stats.copiedFrames = m_copiedFrames;
+        stats.directFrames = m_directFrames;
+        stats.historySeekMicroseconds = m_historySeekMicroseconds;
+        stats.streamSeekMicroseconds = m_streamSeekMicroseconds;
+        stats.skipMicroseconds = m_skipMicroseconds;
+        stats.pauseMicroseconds = m_pauseMicroseconds;
+        stats.resumeMicroseconds = m_resumeMicroseconds;
+    } while ((sequence & 1) || m_totalsSequence.fetchAndAddOrdered(0) != sequence);
+    return stats;
+}
+
+void SoundFeeder::setScheduling(bool realTime, bool roundRobin, int priority, int cpu)
+{
+    m_realTime = realTime;
+    m_roundRobin = roundRobin;
+    m_realTimePriority = priority;
+    m_cpu = cpu;
+}
+
+void SoundFeeder::setLatencyProfile(LatencyTuner::Profile profile)
+{
+    m_latencyTuner.setProfile(profile);
+}
+
+const AudioGraph &SoundFeeder::audioGraph() const
+{
+    return m_graph;
+}
+
+int SoundFeeder::sinkDelay() const
+{
+    return m_sinkDelay;
+}
+
+void SoundFeeder::stop()
+{
+    post(FeederCommandQueue::Stop);
+}
+
+void SoundFeeder::seek(qint64 position)
+{
+    post(FeederCommandQueue::Seek, position);
+}
+
+bool SoundFeeder::seekBack(qint64 position)
+{
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    const PlaybackClock &clock = MainWindow::self()->playbackClock();
+    if (position < 0 || position >= clock.position()) {
+        return false;
+    }
+
+    // Everything written since position has to be in the history, and the
+    // block the feeder may be holding as well. The ring's own format is the
+    // feeder's to read, it may be taking a format change right now.
+    const PlaybackClock::Written written = clock.written();
+    const qint64 frames = (written.position - position) * written.sampleRate / 1000000;
+    if (frames * written.channels + BlockSamples > ring.historySamples()) {
+        return false;
+    }
+
+    post(FeederCommandQueue::Rewind, position);
+    return true;
+}
+
+void SoundFeeder::pause()
+{
+    post(FeederCommandQueue::Pause);
+}
+
+void SoundFeeder::resume()
+{
+    post(FeederCommandQueue::Resume);
+}
+
+void SoundFeeder::wakeUp()
+{
+    m_commands.wakeUp();
+    MainWindow::self()->pcmRing().wakeUp();
+}
+
+void SoundFeeder::setTrackLoudness(double lufs)
+{
+    m_trackLoudness.fetchAndStoreRelaxed(qRound(lufs * 100));
+    m_trackLoudnessPending.fetchAndStoreRelease(1);
+}
+
+void SoundFeeder::setNextTrackLoudness(double lufs)
+{
+    m_nextTrackLoudness.fetchAndStoreRelease(qRound(lufs * 100));
+}
+
+void SoundFeeder::setEqualizer(bool enabled, const QList<Equalizer::Band> &bands)
+{
+    EqualizerSettings &settings = m_equalizerSettings.back();
+    settings.enabled = enabled;
+    settings.bandCount = qMin(bands.count(), int(Equalizer::MaxBands));
+    for (int i = 0; i < settings.bandCount; ++i) {
+        settings.bands[i] = bands[i];
+    }
+    m_equalizerSettings.publish();
+}
+
 void SoundFeeder::run()
 {
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    PcmBlockPool &pool = MainWindow::self()->pcmBlockPool();
+
+    setUpScheduling();
+
+    // The sink might not have taken the format the ring starts with
+    negotiateFormat(AudioSink::Format(ring.sampleRate(), ring.channels()));
+    m_crossfader.setCurve(MainWindow::self()->crossfadeCurve());
+    m_normalizer.setEnabled(MainWindow::self()->normalizationEnabled());
+    m_normalizer.setTargetLoudness(MainWindow::self()->normalizationTarget());
+
     Q_FOREVER {
-        QMutex &m = MainWindow::self()->dataMutex();
-        m.lock();
-        while (!MainWindow::self()->hasChunk() && !MainWindow::self()->isExiting()) {
-            MainWindow::self()->pcmWaitCondition().wait(&m);
-        }
+        handleCommands();
         if (MainWindow::self()->isExiting()) {
-            m.unlock();
             break;
         }
-        Chunk c = MainWindow::self()->nextChunk();
-        m.unlock();
-        if (c.m_dataFrames == -1) {
-            emit pcmWritten(c);
+        if (m_equalizerSettings.fetch()) {
+            const EqualizerSettings &settings = m_equalizerSettings.front();
+            m_equalizer.setBands(settings.enabled, settings.bands, settings.bandCount);
+        }
+        if (m_trackLoudnessPending.fetchAndStoreAcquire(0)) {
+            m_normalizer.startTrack(m_trackLoudness / 100.0);
+        }
+        if (shouldCrossfade()) {
+            holdTail();
+        }
+        if (!ring.readAvailable()) {
+            m_ringWaits.ref();
+            m_latencyTuner.interrupt();
+        }
+        // Commands wake the ring up too
+        while (!ring.waitForData() && m_commands.isEmpty() && !MainWindow::self()->isExiting()) {
+        }
+        if (!m_commands.isEmpty() || MainWindow::self()->isExiting()) {
+            continue;
+        }
+        PcmRingBuffer::Marker marker;
+        if (ring.takeMarker(&marker)) {
+            if (marker.type == PcmRingBuffer::FormatChange) {
+                negotiateFormat(AudioSink::Format(marker.sampleRate, marker.channels));
+                continue;
+            }
+            AudioSink *const sink = MainWindow::self()->audioSink();
+            MainWindow::self()->playbackClock().startTrack(sink->delay(), sink->format().sampleRate);
+            if (m_latencyTuner.trackBoundary(sink->underruns())) {
+                // Let the previous track play out, so that nothing is cut
+                sink->setBuffering(m_latencyTuner.periodFrames(), LatencyTuner::Periods);
+                sink->drain();
+                sink->open(sink->format());
+                m_bufferChanges.ref();
+            }
+            const double loudness = m_normalizer.measuredLoudness();
+            if (loudness != LoudnessNormalizer::UnknownLoudness) {
+                emit trackLoudnessMeasured(loudness);
+            }
+            m_normalizer.startTrack(m_nextTrackLoudness.fetchAndStoreAcquire(LoudnessNormalizer::UnknownLoudness * 100) / 100.0);
+            emit trackBoundaryReached();
             continue;
         }
-        QMutex &m2 = MainWindow::self()->pcmMutex();
-        m2.lock();
-        while (!MainWindow::self()->isPlaying()) {
-            MainWindow::self()->playCondition().wait(&m2);
+        const AudioSink::Format output = m_converter.outputFormat();
+        Chunk c;
+        c.m_block = pool.acquire();
+        c.m_rate = output.sampleRate;
+        c.m_channels = output.channels;
+        if (MainWindow::self()->audioSink()->hasDirectAccess()) {
+            // Audio goes from the ring straight into the sink's buffer and is
+            // processed there; the chunk only gets what the analyzer needs
+            c.m_dataFrames = writeDirect(c.m_block.data());
+            if (!c.m_dataFrames) {
+                continue;
+            }
+            MainWindow::self()->spectrumTap().push(c);
+        } else {
+            c.m_dataFrames = readConverted(c.m_block.data(), BlockSamples / output.channels);
+            if (!c.m_dataFrames) {
+                continue;
+            }
+            m_graph.process(c.m_block.data(), c.m_dataFrames);
+            MainWindow::self()->spectrumTap().push(c);
+            if (!writeToDevice(c.m_block.data(), c.m_dataFrames)) {
+                continue;
+            }
+        }
+        MainWindow::self()->playerState().audioStarted();
+        emit pcmWritten();
+    }
+}
+
+void SoundFeeder::post(FeederCommandQueue::Type type, qint64 position)
+{
+    if (!m_commands.post(type, position)) {
+        kWarning() << "Sound feeder command queue full, dropping command" << type;
+        return;
+    }
+    // The feeder may be waiting for audio rather than for commands
+    MainWindow::self()->pcmRing().wakeUp();
+}
+
+bool SoundFeeder::handleCommands(int heldFrames)
+{
+    PlaybackClock &clock = MainWindow::self()->playbackClock();
+    AudioSink *const sink = MainWindow::self()->audioSink();
+    bool dropped = false;
+
+    Q_FOREVER {
+        FeederCommandQueue::Command command;
+        while (m_commands.take(&command)) {
+            switch (command.type) {
+                case FeederCommandQueue::Stop:
+                case FeederCommandQueue::Seek:
+                    sink->drop();
+                    m_sinkPaused = false;
+                    if (command.type == FeederCommandQueue::Stop) {
+                        m_paused = false;
+                        clock.pause(false);
+                    }
+                    m_graph.reset();
+                    m_converter.reset();
+                    m_latencyTuner.interrupt();
+                    clock.reset(command.position);
+                    m_seekArmed = true;
+                    break;
+                case FeederCommandQueue::Rewind:
+                    rewind(command.position, heldFrames);
+                    m_sinkPaused = false;
+                    break;
+                case FeederCommandQueue::Pause:
+                    if (!m_paused) {
+                        if (!pauseSink(heldFrames)) {
+                            dropped = true;
+                        }
+                        m_paused = true;
+                        m_pauses.ref();
+                        addTotal(&m_pauseMicroseconds, PlaybackClock::now() - command.posted);
+                    }
+                    continue;
+                case FeederCommandQueue::Resume:
+                    if (m_paused) {
+                        resumeSink();
+                        m_paused = false;
+                        m_resumes.ref();
+                        addTotal(&m_resumeMicroseconds, PlaybackClock::now() - command.posted);
+                    }
+                    continue;
+            }
+            m_effectStart = command.posted;
+            m_effectType = command.type;
+            dropped = true;
+        }
+
+        if (!m_paused || MainWindow::self()->isExiting()) {
+            return dropped;
+        }
+        m_commands.wait();
+        m_latencyTuner.interrupt();
+    }
+}
+
+bool SoundFeeder::pauseSink(int heldFrames)
+{
+    AudioSink *const sink = MainWindow::self()->audioSink();
+    MainWindow::self()->playbackClock().pause(true);
+    m_sinkPaused = sink->pause(true);
+    if (!m_sinkPaused) {
+        // Throw away what the sink cannot hold on to, and play it again
+        // from the ring history on resume
+        rewind(MainWindow::self()->playbackClock().position(), heldFrames);
+    }
+    return m_sinkPaused;
+}
+
+void SoundFeeder::resumeSink()
+{
+    if (m_sinkPaused) {
+        MainWindow::self()->audioSink()->pause(false);
+        m_sinkPaused = false;
+    }
+    MainWindow::self()->playbackClock().pause(false);
+}
+
+bool SoundFeeder::shouldCrossfade()
+{
+    const double seconds = MainWindow::self()->crossfadeSeconds();
+    if (seconds <= 0 || m_crossfader.isFading()) {
+        return false;
+    }
+
+    // Fade once the end of the track is close enough and the next track has
+    // started arriving in the same format. Keep some room in the tail buffer
+    // for the frames the resampler may add.
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    const AudioSink::Format output = m_converter.outputFormat();
+    const qint64 tailRoom = qint64(m_crossfader.capacity() / output.channels - 64) * ring.sampleRate() / output.sampleRate;
+    const int maxTail = qMin<qint64>(seconds * ring.sampleRate(), tailRoom);
+    const int tail = ring.readAvailable();
+    return tail > 0 && tail <= maxTail && ring.framesAfterEndOfTrack() > 0;
+}
+
+void SoundFeeder::holdTail()
+{
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    const int channels = m_converter.outputFormat().channels;
+    const int capacity = m_crossfader.capacity() / channels;
+    int16_t *const tail = m_crossfader.tailBuffer();
+
+    int held = 0;
+    Q_FOREVER {
+        const int available = ring.readAvailable();
+        if (!available || held == capacity) {
+            break;
+        }
+        const int read = readConverted(tail + held * channels, qMin(capacity - held, BlockSamples / channels));
+        // Only the nodes that work on each track separately
+        m_graph.process(tail + held * channels, read, &m_crossfader);
+        held += read;
+        if (ring.readAvailable() == available) {
+            break;
+        }
+    }
+
+    m_crossfader.begin(held, channels);
+    m_crossfades.ref();
+}
+
+int SoundFeeder::readConverted(int16_t *output, int outputFrames)
+{
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    if (m_converter.isPassthrough()) {
+        return ring.read(output, outputFrames);
+    }
+
+    const PcmBlock input = MainWindow::self()->pcmBlockPool().acquire();
+    const int inputFrames = ring.read(input.data(), qMin(BlockSamples / ring.channels(),
+                                                         m_converter.maxInputFrames(outputFrames)));
+    return m_converter.convert(input.data(), inputFrames, output);
+}
+
+void SoundFeeder::rewind(qint64 position, int heldFrames)
+{
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    PlaybackClock &clock = MainWindow::self()->playbackClock();
+    AudioSink *const sink = MainWindow::self()->audioSink();
+
+    // The ring has been read up to the sink's written position and the
+    // frames still held, which are in the sink's rate
+    const int held = qint64(heldFrames) * ring.sampleRate() / sink->format().sampleRate;
+    sink->drop();
+    const qint64 written = clock.writtenPosition();
+    const int frames = ring.rewind((written - position) * ring.sampleRate() / 1000000 + held) - held;
+    clock.reset(written - qint64(frames) * 1000000 / ring.sampleRate());
+    m_graph.reset();
+    m_converter.reset();
+    m_latencyTuner.interrupt();
+    m_seekArmed = true;
+}
+
+void SoundFeeder::setUpScheduling()
+{
+    // Scheduling calls take the kernel thread id, which is this thread's
+    // alone, rather than the whole process
+    const pid_t thread = syscall(SYS_gettid);
+
+    if (m_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(m_cpu, &cpus);
+        if (sched_setaffinity(thread, sizeof(cpus), &cpus)) {
+            kWarning() << "Could not pin the sound feeder to CPU" << m_cpu << ":" << strerror(errno);
+        } else {
+            kDebug() << "Sound feeder pinned to CPU" << m_cpu;
+        }
+    }
+
+    if (!m_realTime) {
+        return;
+    }
+
+    const int policy = m_roundRobin ? SCHED_RR : SCHED_FIFO;
+    struct sched_param param;
+    param.sched_priority = qBound(sched_get_priority_min(policy), m_realTimePriority, sched_get_priority_max(policy));
+    const int err = pthread_setschedparam(pthread_self(), policy, &param);
+    if (!err) {
+        m_scheduling.fetchAndStoreRelaxed(RealTimeScheduling);
+        kDebug() << "Sound feeder running" << (m_roundRobin ? "SCHED_RR" : "SCHED_FIFO")
+                 << "at priority" << param.sched_priority;
+    } else {
+        // RLIMIT_NICE may allow some of the way only
+        int nice = -10;
+        while (nice < 0 && setpriority(PRIO_PROCESS, thread, nice)) {
+            ++nice;
+        }
+        if (nice < 0) {
+            m_scheduling.fetchAndStoreRelaxed(NicedScheduling);
+        }
+        kWarning() << "Real time scheduling refused for the sound feeder:" << strerror(err)
+                   << "- running at nice level" << nice;
+    }
+
+    PcmRingBuffer &ring = MainWindow::self()->pcmRing();
+    PcmBlockPool &pool = MainWindow::self()->pcmBlockPool();
+    if (ring.lockMemory() && pool.lockMemory()) {
+        m_memoryLocked.fetchAndStoreRelaxed(1);
+    } else {
+        kWarning() << "Could not lock the sound feeder's buffers in memory:" << strerror(errno);
+    }
+}
+
+void SoundFeeder::negotiateFormat(const AudioSink::Format &source)
+{
+    MainWindow::self()->playbackClock().setSourceFormat(source.sampleRate, source.channels);
+
+    AudioSink *const sink = MainWindow::self()->audioSink();
+    if (source == m_converter.inputFormat() && sink->format() == m_converter.outputFormat()) {
+        return;
+    }
+
+    // Prefer reopening the sink in the source format, so that nothing has to
+    // be converted. Failing that, keep the rate and fall back to stereo, and
+    // as a last resort to what the sink was first opened with.
+    if (sink->format() != source) {
+        sink->drain();
+        if (!sink->open(source) || sink->format() != source) {
+            const AudioSink::Format stereo(source.sampleRate, 2);
+            if (sink->format() != stereo && (!sink->open(stereo) || sink->format().channels != 2)) {
+                sink->open(AudioSink::Format());
+            }
+        }
+    }
+
+    m_converter.setFormats(source, sink->format());
+    m_graph.setFormat(sink->format().sampleRate, sink->format().channels);
+    m_latencyTuner.interrupt();
+    kDebug() << "source:" << source.sampleRate << "Hz" << source.channels << "channels,"
+             << "sink:" << sink->format().sampleRate << "Hz" << sink->format().channels << "channels";
+}
+
+bool SoundFeeder::writeToDevice(const int16_t *data, int frames)
+{
+    AudioSink *const sink = MainWindow::self()->audioSink();
+    const int periodSize = sink->periodSize();
+    const int channels = sink->format().channels;
+    int total = 0;
+
+    while (frames > 0 && !MainWindow::self()->isExiting()) {
+        // Between writes is where commands take effect. The sink has been
+        // emptied if what is left of the block was thrown away.
+        if (!m_commands.isEmpty() && handleCommands(frames)) {
+            return false;
+        }
+        const int avail = sink->avail();
+        if (avail < 0) {
+            return false;
+        }
+        // Only wake up again when the sink can take a full period (the
+        // avail_min it was set up with), or all we have left.
+        if (avail < qMin(frames, periodSize)) {
+            m_deviceWaits.ref();
+            sink->wait(1000);
+            continue;
         }
-        const int written = snd_pcm_writei(MainWindow::self()->pcmHandle(), c.m_data, c.m_dataFrames);
+        const int written = sink->write(data, qMin(avail, frames));
         if (written < 0) {
-            snd_pcm_recover(MainWindow::self()->pcmHandle(), written, 1);
+            return false;
+        }
+        recordFill(sink->bufferSize() - avail, written);
+        recordWrite(written);
+        addTotal(&m_copiedFrames, written);
+        data += written * channels;
+        frames -= written;
+        total += written;
+    }
+
+    finishWrite(total);
+    return true;
+}
+
+int SoundFeeder::writeDirect(int16_t *analyzerCopy)
+{
+    AudioSink *const sink = MainWindow::self()->audioSink();
+    const int channels = sink->format().channels;
+    int frames = 0;
+
+    while (!MainWindow::self()->isExiting()) {
+        if (!m_commands.isEmpty() && handleCommands()) {
+            return 0;
+        }
+        const int avail = sink->avail();
+        if (avail < 0) {
+            return 0;
+        }
+        // How much the ring holds is not known in output frames, so always
+        // wait for a full period
+        if (avail < sink->periodSize()) {
+            m_deviceWaits.ref();
+            sink->wait(1000);
+            continue;
         }
-        m2.unlock();
-        free(c.m_data);
-        if (MainWindow::self()->isPlaying()) {
-            emit pcmWritten(c);
+        int16_t *area;
+        const int length = sink->beginWrite(&area, qMin(avail, BlockSamples / channels));
+        if (length <= 0) {
+            return 0;
         }
-        usleep(10000);
+        frames = readConverted(area, length);
+        m_graph.process(area, frames);
+        memcpy(analyzerCopy, area, qMin(frames, int(AnalyzerFrames)) * channels * sizeof(int16_t));
+        if (sink->commitWrite(frames) < 0) {
+            return 0;
+        }
+        recordFill(sink->bufferSize() - avail, frames);
+        break;
+    }
+
+    if (frames) {
+        recordWrite(frames);
+        addTotal(&m_directFrames, frames);
+    }
+    finishWrite(frames);
+    return qMin(frames, int(AnalyzerFrames));
+}
+
+void SoundFeeder::finishWrite(int total)
+{
+    AudioSink *const sink = MainWindow::self()->audioSink();
+
+    // The first write after a stop or a seek is where it is heard
+    if (m_seekArmed && total) {
+        if (m_effectStart) {
+            const int latency = PlaybackClock::now() - m_effectStart;
+            switch (m_effectType) {
+                case FeederCommandQueue::Rewind:
+                    m_historySeeks.ref();
+                    addTotal(&m_historySeekMicroseconds, latency);
+                    break;
+                case FeederCommandQueue::Seek:
+                    m_streamSeeks.ref();
+                    addTotal(&m_streamSeekMicroseconds, latency);
+                    break;
+                default:
+                    m_skips.ref();
+                    addTotal(&m_skipMicroseconds, latency);
+                    break;
+            }
+            m_effectStart = 0;
+        }
+        m_seekArmed = false;
+    }
+
+    const int delay = sink->delay();
+    m_sinkDelay.fetchAndStoreRelaxed(qint64(delay) * 1000000 / sink->format().sampleRate);
+    MainWindow::self()->playbackClock().framesWritten(total, sink->format().sampleRate, delay);
+}
+
+void SoundFeeder::recordFill(int before, int written)
+{
+    m_latencyTuner.recordFill(before, before + written);
+    m_closeCalls.fetchAndStoreRelaxed(m_latencyTuner.closeCalls());
+}
+
+void SoundFeeder::addTotal(qint64 *total, qint64 amount)
+{
+    m_totalsSequence.fetchAndAddOrdered(1);
+    *total += amount;
+    m_totalsSequence.fetchAndAddOrdered(1);
+}
+
+void SoundFeeder::recordWrite(int frames)
+{
+    // Only the feeder thread writes these, readers just want a snapshot
+    m_writes.ref();
+    addTotal(&m_framesWritten, frames);
+    if (frames < m_minWriteFrames || !m_minWriteFrames) {
+        m_minWriteFrames.fetchAndStoreRelaxed(frames);
+    }
+    if (frames > m_maxWriteFrames) {
+        m_maxWriteFrames.fetchAndStoreRelaxed(frames);
     }
 }
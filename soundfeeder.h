@@ -20,8 +20,17 @@
 #define SOUND_FEEDER_H
 
 #include <QtCore/QThread>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
 
-#include "chunk.h"
+#include "formatconverter.h"
+#include "crossfader.h"
+#include "loudnessnormalizer.h"
+#include "equalizer.h"
+#include "audiograph.h"
+#include "latencytuner.h"
+#include "feedercommandqueue.h"
+#include "triplebuffer.h"
 
 class SoundFeeder
     : public QThread
@@ -29,14 +38,230 @@ class SoundFeeder
     Q_OBJECT
 
 public:
+    // Room for 2048 frames of stereo audio
+    static const int BlockSamples = 8192;
+    // Longest crossfade, at 48kHz stereo
+    static const int CrossfadeSamples = 12 * 48000 * 2;
+    // Most the analyzer looks at of each chunk
+    static const int AnalyzerFrames = 512;
+
+    enum Scheduling {
+        NormalScheduling = 0,
+        NicedScheduling,     ///< real time was refused, running at a raised nice level
+        RealTimeScheduling
+    };
+
+    struct Stats {
+        int ringWaits;     ///< times the feeder slept waiting for audio
+        int deviceWaits;   ///< times the feeder slept waiting for device room
+        int writes;
+        qint64 framesWritten;
+        int minWriteFrames;
+        int maxWriteFrames;
+        qint64 copiedFrames;  ///< frames copied into the sink from a block
+        qint64 directFrames;  ///< frames read straight into the sink's buffer
+        int crossfades;
+        int equalizerBands;  ///< bands filtering right now
+        // Time from a seek to its first frame written to the sink, for
+        // seeks served from the ring history and seeks libspotify served,
+        // and from a stop to the first frame of the next track
+        int historySeeks;
+        qint64 historySeekMicroseconds;
+        int streamSeeks;
+        qint64 streamSeekMicroseconds;
+        int skips;
+        qint64 skipMicroseconds;
+        // Time from posting a pause or a resume until the sink has done it
+        int pauses;
+        qint64 pauseMicroseconds;
+        int resumes;
+        qint64 resumeMicroseconds;
+        int closeCalls;      ///< see LatencyTuner::closeCalls()
+        int bufferChanges;   ///< times the adaptive profile resized the sink
+        Scheduling scheduling;
+        bool memoryLocked;   ///< the ring and the block pool are locked in RAM
+    };
+
     SoundFeeder(QObject *parent = 0);
     virtual ~SoundFeeder();
 
+    Stats stats() const;
+
+    /**
+     * With @p realTime, the feeder asks for SCHED_FIFO (SCHED_RR with
+     * @p roundRobin) at @p priority, settling for a raised nice level, and
+     * locks the ring and the block pool in RAM. A @p cpu other than -1
+     * pins it to that CPU. To be called before start().
+     */
+    void setScheduling(bool realTime, bool roundRobin, int priority, int cpu);
+
+    /**
+     * To be called before start(), with the sink already set up for the
+     * initial period size of @p profile.
+     */
+    void setLatencyProfile(LatencyTuner::Profile profile);
+
+    /**
+     * Processing between the ring and the sink. Only nodeStats() and
+     * compilations() can be called from other threads.
+     */
+    const AudioGraph &audioGraph() const;
+
+    /**
+     * Microseconds of audio written to the sink but not audible yet, as of
+     * the last write. Can be called from any thread.
+     */
+    int sinkDelay() const;
+
+    //BEGIN: control, from the GUI thread
+    // Commands are queued and the feeder applies them between writes, so
+    // none of these ever waits for the sink.
+
+    /**
+     * Throws away what the sink and the feeder hold, for another track to
+     * start from the beginning, and ends any pause. To be called right
+     * after the ring is discarded.
+     */
+    void stop();
+
+    /**
+     * Same as stop(), but for libspotify to go on from @p position, in
+     * microseconds, without ending a pause.
+     */
+    void seek(qint64 position);
+
+    /**
+     * Goes back to @p position, in microseconds, if it is still in the ring
+     * history.
+     * @return false if the caller has to discard the ring, seek() and ask
+     *         libspotify to seek instead.
+     */
+    bool seekBack(qint64 position);
+
+    void pause();
+    void resume();
+
+    /**
+     * Wakes the feeder up wherever it sleeps, for it to notice that the
+     * application is exiting.
+     */
+    void wakeUp();
+    //END: control, from the GUI thread
+
+    /**
+     * Integrated loudness of the track now playing, or of the one queued
+     * after it, in LUFS or LoudnessNormalizer::UnknownLoudness. Can be
+     * called from any thread.
+     */
+    void setTrackLoudness(double lufs);
+    void setNextTrackLoudness(double lufs);
+
+    /**
+     * Bands the equalizer glides to. To be called from the GUI thread only.
+     */
+    void setEqualizer(bool enabled, const QList<Equalizer::Band> &bands);
+
 Q_SIGNALS:
-    void pcmWritten(const Chunk &chunk);
+    /**
+     * A block has been written to the sink. Carries nothing, so that a busy
+     * GUI thread does not hold on to blocks of the pool.
+     */
+    void pcmWritten();
+
+    /**
+     * The last frame of a track has been written to the sink, and what
+     * follows belongs to the next one.
+     */
+    void trackBoundaryReached();
+
+    /**
+     * Emitted right before trackBoundaryReached() with the loudness of the
+     * track that just finished, if enough of it was measured.
+     */
+    void trackLoudnessMeasured(double lufs);
 
 protected:
     virtual void run();
+
+private:
+    struct EqualizerSettings {
+        bool            enabled;
+        Equalizer::Band bands[Equalizer::MaxBands];
+        int             bandCount;
+    };
+
+    void setUpScheduling();
+    void post(FeederCommandQueue::Type type, qint64 position = 0);
+    bool handleCommands(int heldFrames = 0);
+    bool pauseSink(int heldFrames);
+    void resumeSink();
+    void negotiateFormat(const AudioSink::Format &source);
+    void rewind(qint64 position, int heldFrames = 0);
+    bool shouldCrossfade();
+    void holdTail();
+    int readConverted(int16_t *output, int outputFrames);
+    bool writeToDevice(const int16_t *data, int frames);
+    int writeDirect(int16_t *analyzerCopy);
+    void finishWrite(int total);
+    void recordFill(int before, int written);
+    void recordWrite(int frames);
+    void addTotal(qint64 *total, qint64 amount);
+
+    bool               m_realTime;
+    bool               m_roundRobin;
+    int                m_realTimePriority;
+    int                m_cpu;
+    FormatConverter    m_converter;
+    Crossfader         m_crossfader;
+    LatencyTuner       m_latencyTuner;
+    FeederCommandQueue m_commands;
+    bool               m_paused;
+    // Whether the sink itself is paused, rather than emptied
+    bool               m_sinkPaused;
+    // The stop or seek to time until its first write, if any
+    qint64             m_effectStart;
+    FeederCommandQueue::Type m_effectType;
+    // Whether the next write is the first one after a stop or seek
+    bool               m_seekArmed;
+    LoudnessNormalizer m_normalizer;
+    // Hundredths of LU, set from other threads
+    QAtomicInt         m_trackLoudness;
+    QAtomicInt         m_trackLoudnessPending;
+    QAtomicInt         m_nextTrackLoudness;
+    Equalizer          m_equalizer;
+    AudioGraph         m_graph;
+    // Bands set from the GUI thread, fetched before each block
+    TripleBuffer<EqualizerSettings> m_equalizerSettings;
+
+    mutable QAtomicInt m_ringWaits;
+    mutable QAtomicInt m_deviceWaits;
+    mutable QAtomicInt m_writes;
+    mutable QAtomicInt m_minWriteFrames;
+    mutable QAtomicInt m_maxWriteFrames;
+    mutable QAtomicInt m_sinkDelay;
+    mutable QAtomicInt m_crossfades;
+    mutable QAtomicInt m_historySeeks;
+    mutable QAtomicInt m_streamSeeks;
+    mutable QAtomicInt m_skips;
+    mutable QAtomicInt m_pauses;
+    mutable QAtomicInt m_resumes;
+    mutable QAtomicInt m_closeCalls;
+    mutable QAtomicInt m_bufferChanges;
+    mutable QAtomicInt m_scheduling;
+    mutable QAtomicInt m_memoryLocked;
+
+    // Totals that would wrap in 32 bits within a day of playback. Only the
+    // feeder thread adds to them, through addTotal(). Seqlock: odd while
+    // being updated.
+    mutable QAtomicInt m_totalsSequence;
+    qint64             m_framesWritten;
+    qint64             m_copiedFrames;
+    qint64             m_directFrames;
+    qint64             m_historySeekMicroseconds;
+    qint64             m_streamSeekMicroseconds;
+    qint64             m_skipMicroseconds;
+    qint64             m_pauseMicroseconds;
+    qint64             m_resumeMicroseconds;
 };
 
 #endif
@@ -0,0 +1,119 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "spectrumtap.h"
+
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+
+SpectrumTap::SpectrumTap()
+    : m_eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_writePos(0)
+    , m_readPos(0)
+    , m_pushed(0)
+    , m_dropped(0)
+{
+}
+
+SpectrumTap::~SpectrumTap()
+{
+    if (m_eventFd != -1) {
+        close(m_eventFd);
+    }
+}
+
+bool SpectrumTap::push(const Chunk &chunk)
+{
+    const uint32_t writePos = m_writePos;
+    if (writePos - uint32_t(m_readPos.fetchAndAddAcquire(0)) == Capacity) {
+        m_dropped.ref();
+        return false;
+    }
+
+    m_chunks[writePos % Capacity] = chunk;
+    m_writePos.fetchAndStoreRelease(writePos + 1);
+    m_pushed.ref();
+    wakeUp();
+    return true;
+}
+
+bool SpectrumTap::isEmpty() const
+{
+    return m_writePos.fetchAndAddAcquire(0) == m_readPos;
+}
+
+bool SpectrumTap::take(Chunk *chunk)
+{
+    const uint32_t readPos = m_readPos;
+    if (uint32_t(m_writePos.fetchAndAddAcquire(0)) == readPos) {
+        return false;
+    }
+
+    // Leave the slot empty, so the block goes back to the pool as soon as
+    // the consumer is done with it
+    Chunk &slot = m_chunks[readPos % Capacity];
+    *chunk = slot;
+    slot.m_block = PcmBlock();
+    m_readPos.fetchAndStoreRelease(readPos + 1);
+    return true;
+}
+
+bool SpectrumTap::wait(int timeout)
+{
+    if (isEmpty()) {
+        pollfd pfd;
+        pfd.fd = m_eventFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        while (poll(&pfd, 1, timeout) == -1 && errno == EINTR) {
+        }
+    }
+    uint64_t value;
+    while (::read(m_eventFd, &value, sizeof(value)) == -1 && errno == EINTR) {
+    }
+
+    return !isEmpty();
+}
+
+void SpectrumTap::clear()
+{
+    Chunk chunk;
+    while (take(&chunk)) {
+    }
+}
+
+void SpectrumTap::wakeUp()
+{
+    const uint64_t one = 1;
+    while (::write(m_eventFd, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+}
+
+int SpectrumTap::pushed() const
+{
+    return m_pushed;
+}
+
+int SpectrumTap::dropped() const
+{
+    return m_dropped;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPECTRUMTAP_H
+#define SPECTRUMTAP_H
+
+#include "chunk.h"
+
+#include <QtCore/QAtomicInt>
+
+/**
+ * Where the sound feeder leaves what it wrote for the analyzer to look at.
+ *
+ * Fixed capacity, single producer/single consumer queue of chunks. The
+ * producer is the sound feeder, the consumer is the spectrum thread.
+ * Chunks only hold a reference to their PcmBlock, so pushing one copies no
+ * audio and takes no lock. When the consumer falls behind, chunks are
+ * dropped rather than making the feeder wait: the analyzer can skip a
+ * frame, the sink cannot.
+ */
+class SpectrumTap
+{
+public:
+    static const int Capacity = 8;
+
+    SpectrumTap();
+    ~SpectrumTap();
+
+    //BEGIN: producer side
+    /**
+     * Returns false if the chunk was dropped because the tap is full.
+     */
+    bool push(const Chunk &chunk);
+    //END: producer side
+
+    //BEGIN: consumer side
+    bool isEmpty() const;
+    bool take(Chunk *chunk);
+
+    /**
+     * Sleeps until a chunk is pushed, wakeUp() is called or @p timeout
+     * milliseconds have passed. Returns whether there is a chunk.
+     */
+    bool wait(int timeout = -1);
+
+    /**
+     * Drops the chunks still in the tap, giving their blocks back.
+     */
+    void clear();
+    //END: consumer side
+
+    /**
+     * Interrupts wait(). Can be called from any thread.
+     */
+    void wakeUp();
+
+    int pushed() const;
+    int dropped() const;
+
+private:
+    Chunk              m_chunks[Capacity];
+    int                m_eventFd;
+    mutable QAtomicInt m_writePos;
+    mutable QAtomicInt m_readPos;
+    mutable QAtomicInt m_pushed;
+    mutable QAtomicInt m_dropped;
+};
+
+#endif
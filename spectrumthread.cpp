@@ -0,0 +1,63 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "spectrumthread.h"
+#include "spectrumtap.h"
+#include "analyzerbase.h"
+#include "mainwindow.h"
+
+SpectrumThread::SpectrumThread(QObject *parent)
+    : QThread(parent)
+    , m_analyzer(0)
+    , m_frames(0)
+{
+}
+
+SpectrumThread::~SpectrumThread()
+{
+}
+
+void SpectrumThread::setAnalyzer(Analyzer::Base *analyzer)
+{
+    m_analyzer = analyzer;
+}
+
+int SpectrumThread::frames() const
+{
+    return m_frames;
+}
+
+void SpectrumThread::run()
+{
+    SpectrumTap &tap = MainWindow::self()->spectrumTap();
+
+    while (!MainWindow::self()->isExiting()) {
+        Chunk chunk;
+        if (!tap.take(&chunk)) {
+            tap.wait();
+            continue;
+        }
+        if (m_analyzer) {
+            m_analyzer->processChunk(chunk, !tap.isEmpty());
+            m_frames.ref();
+        }
+    }
+
+    tap.clear();
+}
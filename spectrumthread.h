@@ -0,0 +1,66 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SPECTRUMTHREAD_H
+#define SPECTRUMTHREAD_H
+
+#include <QtCore/QThread>
+#include <QtCore/QAtomicInt>
+
+namespace Analyzer {
+    class Base;
+}
+
+/**
+ * Computes the analyzer's spectra, away from both the sound feeder and the
+ * GUI.
+ *
+ * It takes what the feeder left in MainWindow::spectrumTap() and hands it
+ * to the analyzer's processChunk(), which publishes a spectrum for the
+ * next paint. The sound feeder never does any transform or touches a
+ * widget, and a slow analyzer only makes the tap drop chunks.
+ */
+class SpectrumThread
+    : public QThread
+{
+    Q_OBJECT
+
+public:
+    SpectrumThread(QObject *parent = 0);
+    virtual ~SpectrumThread();
+
+    /**
+     * Set before start().
+     */
+    void setAnalyzer(Analyzer::Base *analyzer);
+
+    /**
+     * Chunks handed to the analyzer.
+     */
+    int frames() const;
+
+protected:
+    virtual void run();
+
+private:
+    Analyzer::Base     *m_analyzer;
+    mutable QAtomicInt  m_frames;
+};
+
+#endif
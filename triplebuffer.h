@@ -0,0 +1,89 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QtCore/QAtomicInt>
+
+/**
+ * Three values of T handed from one writer thread to one reader thread
+ * without either waiting for the other.
+ *
+ * The writer fills back() and publishes it; the reader fetches the latest
+ * published value into front() whenever it wants one. Values the reader
+ * was too slow to fetch are overwritten, and the writer can publish again
+ * while the reader is still looking at front(). No call ever blocks.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+        : m_back(0)
+        , m_middle(1)
+        , m_front(2)
+    {
+    }
+
+    //BEGIN: writer side
+    T &back()
+    {
+        return m_values[m_back];
+    }
+
+    void publish()
+    {
+        m_back = m_middle.fetchAndStoreOrdered(m_back | Fresh) & IndexMask;
+    }
+    //END: writer side
+
+    //BEGIN: reader side
+    /**
+     * Makes the latest published value front(). Returns false, leaving
+     * front() alone, if nothing was published since the previous fetch.
+     */
+    bool fetch()
+    {
+        if (!(m_middle.fetchAndAddAcquire(0) & Fresh)) {
+            return false;
+        }
+        m_front = m_middle.fetchAndStoreOrdered(m_front) & IndexMask;
+        return true;
+    }
+
+    const T &front() const
+    {
+        return m_values[m_front];
+    }
+    //END: reader side
+
+private:
+    // The middle index, with a flag telling whether the writer has put a
+    // value there that the reader has not fetched yet
+    static const int IndexMask = 3;
+    static const int Fresh = 4;
+
+    T          m_values[3];
+    int        m_back;
+    QAtomicInt m_middle;
+    int        m_front;
+};
+
+#endif
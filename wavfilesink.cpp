@@ -0,0 +1,152 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wavfilesink.h"
+
+#include <QtCore/QtEndian>
+
+#include <string.h>
+
+#include <KDebug>
+
+WavFileSink::WavFileSink(const QString &fileName)
+    : m_file(fileName)
+    , m_dataBytes(0)
+{
+}
+
+WavFileSink::~WavFileSink()
+{
+    close();
+}
+
+bool WavFileSink::open(const Format &format)
+{
+    if (m_file.isOpen() && format == m_format) {
+        return true;
+    }
+    close();
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        kWarning() << "Could not open" << m_file.fileName() << "for writing:" << m_file.errorString();
+        return false;
+    }
+    m_format = format;
+    m_dataBytes = 0;
+    writeHeader();
+    return true;
+}
+
+void WavFileSink::close()
+{
+    if (m_file.isOpen()) {
+        writeHeader();
+        m_file.close();
+    }
+}
+
+AudioSink::Format WavFileSink::format() const
+{
+    return m_format;
+}
+
+int WavFileSink::periodSize() const
+{
+    return PeriodSize;
+}
+
+int WavFileSink::avail()
+{
+    return PeriodSize;
+}
+
+bool WavFileSink::wait(int timeout)
+{
+    Q_UNUSED(timeout);
+    return true;
+}
+
+int WavFileSink::write(const int16_t *data, int frames)
+{
+    if (!m_file.isOpen()) {
+        return frames;
+    }
+    const int samples = frames * m_format.channels;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    int16_t swapped[PeriodSize];
+    for (int i = 0; i < samples; i += PeriodSize) {
+        const int count = qMin(PeriodSize, samples - i);
+        for (int j = 0; j < count; ++j) {
+            swapped[j] = qToLittleEndian(data[i + j]);
+        }
+        m_file.write(reinterpret_cast<const char*>(swapped), count * sizeof(int16_t));
+    }
+#else
+    m_file.write(reinterpret_cast<const char*>(data), samples * sizeof(int16_t));
+#endif
+    m_dataBytes += samples * sizeof(int16_t);
+    return frames;
+}
+
+void WavFileSink::drain()
+{
+    // Keep the header valid in case we never get to close the file
+    if (m_file.isOpen()) {
+        writeHeader();
+        m_file.flush();
+    }
+}
+
+void WavFileSink::drop()
+{
+}
+
+bool WavFileSink::pause(bool pause)
+{
+    Q_UNUSED(pause);
+    return true;
+}
+
+int WavFileSink::delay()
+{
+    return 0;
+}
+
+void WavFileSink::writeHeader()
+{
+    const quint16 blockAlign = m_format.channels * sizeof(int16_t);
+    uchar header[HeaderSize];
+    memcpy(header, "RIFF", 4);
+    qToLittleEndian<quint32>(HeaderSize - 8 + m_dataBytes, header + 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, header + 16);                                 // fmt chunk size
+    qToLittleEndian<quint16>(1, header + 20);                                  // PCM
+    qToLittleEndian<quint16>(m_format.channels, header + 22);
+    qToLittleEndian<quint32>(m_format.sampleRate, header + 24);
+    qToLittleEndian<quint32>(m_format.sampleRate * blockAlign, header + 28);   // byte rate
+    qToLittleEndian<quint16>(blockAlign, header + 32);
+    qToLittleEndian<quint16>(16, header + 34);                                 // bits per sample
+    memcpy(header + 36, "data", 4);
+    qToLittleEndian<quint32>(m_dataBytes, header + 40);
+
+    const qint64 position = m_file.pos();
+    m_file.seek(0);
+    m_file.write(reinterpret_cast<const char*>(header), HeaderSize);
+    if (position > HeaderSize) {
+        m_file.seek(position);
+    }
+}
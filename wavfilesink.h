@@ -0,0 +1,60 @@
+/*
+ * This file is part of Spokify.
+ * Copyright (C) 2010 Rafael Fernández López <ereslibre@kde.org>
+ *
+ * Spokify is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Spokify is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Spokify.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAVFILESINK_H
+#define WAVFILESINK_H
+
+#include "audiosink.h"
+
+#include <QtCore/QFile>
+
+/**
+ * Sink that records everything into a RIFF/WAVE file, as fast as it is
+ * written. Reopening it with a different format starts the file over.
+ */
+class WavFileSink
+    : public AudioSink
+{
+public:
+    WavFileSink(const QString &fileName);
+    virtual ~WavFileSink();
+
+    virtual bool open(const Format &format);
+    virtual void close();
+    virtual Format format() const;
+    virtual int periodSize() const;
+    virtual int avail();
+    virtual bool wait(int timeout);
+    virtual int write(const int16_t *data, int frames);
+    virtual void drain();
+    virtual void drop();
+    virtual bool pause(bool pause);
+    virtual int delay();
+
+private:
+    static const int PeriodSize = 4096;
+    static const int HeaderSize = 44;
+
+    void writeHeader();
+
+    QFile   m_file;
+    Format  m_format;
+    quint32 m_dataBytes;
+};
+
+#endif